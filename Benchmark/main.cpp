@@ -0,0 +1,417 @@
+#include "bitpacking.hpp"
+#include "compress.h"
+#include "container.h"
+#include "decode.h"
+#include "lz78encode.hpp"
+#include "packbits.hpp"
+#include "pipeline.h"
+#include "snappy.hpp"
+
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Benchmark [--root DIR] [--warmup N] [--repetitions N] [--only SUBSTRING]
+// Runs every codec on the sample files of the repository and on generated data, prints the results as JSON.
+
+namespace {
+
+struct options
+{
+    std::string root = CORPUS_DIR;
+    int warmup = 1;
+    int repetitions = 5;
+    std::string only; // run only the codecs containing this
+};
+
+struct measurement
+{
+    std::string codec, input;
+    size_t uncompressed_bytes, compressed_bytes;
+    double seconds_min, seconds_median;
+    long peak_rss_kb;
+};
+
+// Linux resets the peak RSS (VmHWM) of the process when 5 is written to clear_refs
+bool reset_peak_rss() {
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    return static_cast<bool>(clear_refs << "5" << std::flush);
+}
+
+long peak_rss_kb() {
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line)) {
+        if (line.rfind("VmHWM:", 0) == 0) {
+            return std::strtol(line.c_str() + 6, nullptr, 10);
+        }
+    }
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+std::string read_file(const std::string& filename) {
+    std::ifstream is(filename, std::ios::binary);
+    std::stringstream ss;
+    ss << is.rdbuf();
+    return ss.str();
+}
+
+std::string synthetic_text(size_t size, std::mt19937& rng) {
+    static const char* const words[] = {"lorem", "ipsum", "dolor", "sit", "amet", "consectetur", "adipiscing", "elit",
+                                        "sed", "do", "eiusmod", "tempor", "incididunt", "ut", "labore", "et", "dolore",
+                                        "magna", "aliqua", "the", "of", "and", "in", "codec", "multimedia", "data"};
+    std::string text;
+    while (text.size() < size) {
+        text += words[rng() % std::size(words)];
+        text += rng() % 12 == 0 ? '\n' : ' ';
+    }
+    text.resize(size);
+    return text;
+}
+
+// runs of 1 to 200 equal bytes mixed with short random stretches, the friendly case for PackBits
+std::string synthetic_runs(size_t size, std::mt19937& rng) {
+    std::string data;
+    while (data.size() < size) {
+        if (rng() % 4 == 0) {
+            for (size_t i = rng() % 16 + 1; i > 0; i--) {
+                data += static_cast<char>(rng());
+            }
+        } else {
+            data.append(rng() % 200 + 1, static_cast<char>(rng()));
+        }
+    }
+    data.resize(size);
+    return data;
+}
+
+std::string synthetic_random(size_t size, std::mt19937& rng) {
+    std::string data(size, '\0');
+    for (auto& c : data) {
+        c = static_cast<char>(rng());
+    }
+    return data;
+}
+
+// smooth gradients with flat blocks, roughly what a rendered image looks like
+std::string synthetic_ppm(int width, int height) {
+    std::string ppm = "P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            for (int c = 0; c < 3; c++) {
+                int v = 128 + static_cast<int>(60 * std::sin(x / 50.0 + c) + 50 * std::cos(y / 40.0));
+                if ((x / 80 + y / 60) % 3 == 0) {
+                    v = x * 255 / width;
+                }
+                ppm += static_cast<char>(std::clamp(v, 0, 255));
+            }
+        }
+    }
+    return ppm;
+}
+
+class benchmark
+{
+    const options& options_;
+    std::vector<measurement> results_;
+
+public:
+    explicit benchmark(const options& options) : options_(options) {}
+
+    /*
+     * Runs f warmup times and then repetitions times. f returns the size of its output; compress tells whether
+     * that is the compressed side (encoders) or the uncompressed side (decoders) of input_bytes.
+     */
+    void run(const std::string& codec, const std::string& input, size_t input_bytes, bool compress, const std::function<size_t()>& f) {
+        if (!options_.only.empty() && codec.find(options_.only) == std::string::npos) {
+            return;
+        }
+        std::cerr << codec << " " << input << std::endl;
+        reset_peak_rss();
+        size_t output_bytes = 0;
+        for (int i = 0; i < options_.warmup; i++) {
+            output_bytes = f();
+        }
+        std::vector<double> seconds;
+        for (int i = 0; i < options_.repetitions; i++) {
+            const auto start = std::chrono::steady_clock::now();
+            output_bytes = f();
+            seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        std::sort(seconds.begin(), seconds.end());
+
+        measurement m;
+        m.codec = codec;
+        m.input = input;
+        m.uncompressed_bytes = compress ? input_bytes : output_bytes;
+        m.compressed_bytes = compress ? output_bytes : input_bytes;
+        m.seconds_min = seconds.empty() ? 0 : seconds.front();
+        m.seconds_median = seconds.empty() ? 0 : seconds[seconds.size() / 2];
+        m.peak_rss_kb = peak_rss_kb();
+        results_.push_back(m);
+    }
+
+    void write_json(std::ostream& os) const {
+        os << "{\n";
+        os << "  \"warmup\": " << options_.warmup << ",\n";
+        os << "  \"repetitions\": " << options_.repetitions << ",\n";
+        os << "  \"results\": [";
+        for (size_t i = 0; i < results_.size(); i++) {
+            const auto& m = results_[i];
+            // throughput and ns/byte always refer to the uncompressed size
+            const double mb_per_s = m.seconds_median > 0 ? m.uncompressed_bytes / m.seconds_median / 1e6 : 0;
+            const double ns_per_byte = m.uncompressed_bytes > 0 ? m.seconds_median * 1e9 / m.uncompressed_bytes : 0;
+            const double ratio = m.compressed_bytes > 0 ? static_cast<double>(m.uncompressed_bytes) / m.compressed_bytes : 0;
+            os << (i == 0 ? "\n" : ",\n");
+            os << "    {\"codec\": \"" << m.codec << "\", \"input\": \"" << m.input << "\""
+               << ", \"uncompressed_bytes\": " << m.uncompressed_bytes << ", \"compressed_bytes\": " << m.compressed_bytes
+               << ", \"ratio\": " << ratio << ", \"seconds_min\": " << m.seconds_min << ", \"seconds_median\": " << m.seconds_median
+               << ", \"mb_per_s\": " << mb_per_s << ", \"ns_per_byte\": " << ns_per_byte << ", \"peak_rss_kb\": " << m.peak_rss_kb << "}";
+        }
+        os << "\n  ]\n}" << std::endl;
+    }
+};
+
+struct corpus_file
+{
+    std::string name; // relative to the root, or synthetic/...
+    std::string data;
+};
+
+// the files that exist, a missing one is reported and skipped
+std::vector<corpus_file> load(const options& options, const std::vector<std::string>& names) {
+    std::vector<corpus_file> files;
+    for (const auto& name : names) {
+        const auto path = std::filesystem::path(options.root) / name;
+        if (!std::filesystem::is_regular_file(path)) {
+            std::cerr << "skipping missing " << path.string() << std::endl;
+            continue;
+        }
+        files.push_back({name, read_file(path.string())});
+    }
+    return files;
+}
+
+void run_snappy(benchmark& bench, const options& options) {
+    for (const auto& file : load(options, {"MDPExam/lipsum.txt.snappy", "MDPExam/html_x_4.snappy", "MDPExam/bibbia.txt.snappy"})) {
+        bench.run("snappy_decompress", file.name, file.data.size(), false, [&] {
+            std::istringstream is(file.data);
+            std::ostringstream os;
+            snappy_decompress(is, os);
+            return static_cast<size_t>(os.tellp());
+        });
+    }
+}
+
+void run_lz78(benchmark& bench, const options& options, const std::vector<corpus_file>& synthetic) {
+    auto files = load(options, {"MDPExam6/test1.txt", "MDPExam6/test2.txt", "MDPExam/lipsum.txt", "MDPExam/html_x_4"});
+    files.push_back(synthetic[0]);
+    for (const auto& file : files) {
+        for (const int maxbits : {12, 16}) {
+            bench.run("lz78_encode_" + std::to_string(maxbits), file.name, file.data.size(), true, [&] {
+                std::istringstream is(file.data);
+                std::ostringstream os;
+                lz78encode(is, os, maxbits);
+                return static_cast<size_t>(os.tellp());
+            });
+        }
+    }
+}
+
+void run_packbits(benchmark& bench, const options& options, const std::vector<corpus_file>& synthetic) {
+    auto files = load(options, {"Packbits/data/1/compressme1.txt", "Packbits/data/1/compressme2.txt", "Packbits/data/1/compressme3.txt"});
+    files.insert(files.end(), synthetic.begin(), synthetic.end());
+    for (const auto& file : files) {
+        std::ostringstream packed;
+        {
+            std::istringstream is(file.data);
+            packbits_compress(is, packed);
+        }
+        const std::string codes = packed.str();
+        bench.run("packbits_compress", file.name, file.data.size(), true, [&] {
+            std::istringstream is(file.data);
+            std::ostringstream os;
+            packbits_compress(is, os);
+            return static_cast<size_t>(os.tellp());
+        });
+        bench.run("packbits_decompress", file.name, codes.size(), false, [&] {
+            std::istringstream is(codes);
+            std::ostringstream os;
+            packbits_decompress(is, os);
+            return static_cast<size_t>(os.tellp());
+        });
+
+        // the MDPExam7 encoder works on planes in memory
+        mat<uint8_t> plane(1, file.data.size());
+        std::copy(file.data.begin(), file.data.end(), plane.data());
+        std::vector<uint8_t> encoded;
+        PackBitsEncode(plane, encoded);
+        bench.run("mdp7_packbits_encode", file.name, file.data.size(), true, [&] {
+            std::vector<uint8_t> out;
+            PackBitsEncode(plane, out);
+            return out.size();
+        });
+        bench.run("mdp7_packbits_decode", file.name, encoded.size(), false, [&] {
+            std::vector<uint8_t> out(plane.size());
+            PackBitsDecode(encoded.data(), encoded.size(), out.data(), out.size());
+            return out.size();
+        });
+    }
+}
+
+void run_bitpacking(benchmark& bench) {
+    constexpr size_t NUM_VALUES = 1 << 20;
+    std::mt19937 rng(42);
+    for (const size_t bits : {6, 13, 27}) {
+        std::vector<int64_t> values(NUM_VALUES);
+        const int64_t range = int64_t{1} << (bits - 1);
+        for (auto& value : values) {
+            value = static_cast<int64_t>(rng() % (2 * range)) - range;
+        }
+        const std::string input = "synthetic/" + std::to_string(NUM_VALUES) + "_values_" + std::to_string(bits) + "_bits";
+        Bitpacker<int64_t> packer;
+        packer.pack_values(values, bits);
+        const size_t packed_bytes = packer.packed().size() * sizeof(int64_t);
+
+        bench.run("bitpacking_pack", input, values.size() * sizeof(int64_t), true, [&] {
+            Bitpacker<int64_t> b;
+            b.pack_values(values, bits);
+            return b.packed().size() * sizeof(int64_t);
+        });
+        bench.run("bitpacking_unpack", input, packed_bytes, false, [&] {
+            return packer.get_values(bits).size() * sizeof(int64_t);
+        });
+        // a range predicate selecting about a third of the values, on the packed codes and after unpacking them
+        const int64_t lower = -range / 2, upper = range / 6;
+        bench.run("bitpacking_scan", input, packed_bytes, false, [&] {
+            return packer.scan_between(lower, upper, bits).size() * sizeof(int64_t);
+        });
+        bench.run("bitpacking_unpack_filter", input, packed_bytes, false, [&] {
+            const auto unpacked = packer.get_values(bits);
+            Bitmap selection(unpacked.size());
+            for (size_t i = 0; i < unpacked.size(); i++) {
+                if (unpacked[i] >= lower && unpacked[i] <= upper) {
+                    selection.set(i);
+                }
+            }
+            return selection.size() * sizeof(int64_t);
+        });
+    }
+}
+
+void run_images(benchmark& bench, const options& options) {
+    std::vector<std::pair<std::string, std::string>> images; // name, path
+    for (const std::string name : {"MDPExam7/facolta.ppm", "MDPExam7/test.ppm"}) {
+        const auto path = std::filesystem::path(options.root) / name;
+        if (std::filesystem::is_regular_file(path)) {
+            images.emplace_back(name, path.string());
+        } else {
+            std::cerr << "skipping missing " << path.string() << std::endl;
+        }
+    }
+    // the pipeline reads files, so the generated image is written to a temporary one
+    const auto synthetic_path = std::filesystem::temp_directory_path() / "benchmark_synthetic.ppm";
+    {
+        std::ofstream os(synthetic_path, std::ios::binary);
+        const std::string ppm = synthetic_ppm(1024, 768);
+        os.write(ppm.data(), ppm.size());
+    }
+    images.emplace_back("synthetic/smooth_1024x768.ppm", synthetic_path.string());
+
+    for (const auto& [name, path] : images) {
+        const size_t size = std::filesystem::file_size(path);
+        for (const bool filter : {false, true}) {
+            const std::string suffix = filter ? "_filtered" : "";
+            bench.run("mdp7_json" + suffix, name, size, true, [&] {
+                std::ostringstream os;
+                StreamJSON(path, os, filter);
+                return static_cast<size_t>(os.tellp());
+            });
+            bench.run("mdp7_container" + suffix, name, size, true, [&] {
+                std::ostringstream os;
+                StreamContainer(path, os, filter);
+                return static_cast<size_t>(os.tellp());
+            });
+
+            std::ostringstream packed;
+            StreamContainer(path, packed, filter);
+            const std::string container = packed.str();
+            bench.run("mdp7_decode_container" + suffix, name, container.size(), false, [&] {
+                container_view view;
+                mat<vec3b> img;
+                view.open(reinterpret_cast<const uint8_t*>(container.data()), container.size());
+                DecodeImage(view.codes(), img);
+                return img.rawsize();
+            });
+        }
+    }
+    std::filesystem::remove(synthetic_path);
+}
+
+// int >= min_value without trailing characters, atoi would turn "abc" into 0 repetitions
+bool parse_count(const char* text, int min_value, int& count) {
+    char* end;
+    errno = 0;
+    const long value = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || errno == ERANGE || value < min_value || value > INT32_MAX) {
+        return false;
+    }
+    count = static_cast<int>(value);
+    return true;
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    options options;
+    for (int i = 1; i < argc; i += 2) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        if (arg == "--root" && has_value) {
+            options.root = argv[i + 1];
+        } else if ((arg == "--warmup" || arg == "--repetitions") && has_value) {
+            // no warmup is fine, but there has to be a measured repetition
+            const int min_value = arg == "--warmup" ? 0 : 1;
+            if (!parse_count(argv[i + 1], min_value, arg == "--warmup" ? options.warmup : options.repetitions)) {
+                std::cerr << arg << " needs a number >= " << min_value << ", not " << argv[i + 1] << std::endl;
+                return 1;
+            }
+        } else if (arg == "--only" && has_value) {
+            options.only = argv[i + 1];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--root DIR] [--warmup N] [--repetitions N] [--only SUBSTRING]" << std::endl;
+            return 1;
+        }
+    }
+
+    std::mt19937 rng(1);
+    const std::vector<corpus_file> synthetic = {
+        {"synthetic/text_256K", synthetic_text(256 << 10, rng)},
+        {"synthetic/runs_1M", synthetic_runs(1 << 20, rng)},
+        {"synthetic/random_1M", synthetic_random(1 << 20, rng)},
+    };
+
+    benchmark bench(options);
+    run_snappy(bench, options);
+    run_lz78(bench, options, synthetic);
+    run_packbits(bench, options, synthetic);
+    run_bitpacking(bench);
+    run_images(bench, options);
+    bench.write_json(std::cout);
+    return 0;
+}
@@ -0,0 +1,523 @@
+#pragma once
+
+#include "codec_stats.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <thread>
+#include <type_traits>
+
+/**
+ * Sequential reader for the MSB-first bit stream written by Bitpacker.
+ * Words are consumed one at a time, so a value may straddle word boundaries.
+ */
+template <typename T>
+class bit_reader {
+    using U = std::make_unsigned_t<T>;
+    static constexpr size_t WORD_BITS = 8 * sizeof(U);
+
+    const T* _pos;
+    const T* _end;
+    U _word;
+    size_t _word_bits_left;
+
+public:
+    bit_reader(const T* begin, const T* end) : _pos{begin}, _end{end}, _word{0}, _word_bits_left{0} {}
+
+    // returns the next `bits` bits (at most 64) as unsigned integer, without sign extension
+    uint64_t read(size_t bits) {
+        assert(bits > 0 && bits <= 64);
+        uint64_t result = 0;
+        while (bits > 0) {
+            if (_word_bits_left == 0) {
+                _word = _pos < _end ? static_cast<U>(*_pos++) : 0;
+                _word_bits_left = WORD_BITS;
+            }
+            const size_t take = std::min(bits, _word_bits_left);
+            uint64_t chunk = static_cast<uint64_t>(_word) >> (_word_bits_left - take);
+            if (take < 64) {
+                chunk &= (uint64_t{1} << take) - 1;
+                result = (result << take) | chunk;
+            } else {
+                result = chunk;
+            }
+            _word_bits_left -= take;
+            bits -= take;
+        }
+        return result;
+    }
+};
+
+/**
+ * Selection bitmap returned by the Bitpacker scans: bit i is set if value i matched the predicate.
+ * Bitmaps of equally long columns can be combined with & and |.
+ */
+class Bitmap {
+public:
+    explicit Bitmap(size_t size = 0) : _words((size + 63) / 64, 0), _size{size} {}
+
+    size_t size() const { return _size; }
+
+    bool test(size_t position) const {
+        assert(position < _size);
+        return (_words[position / 64] >> (position % 64)) & 1;
+    }
+
+    void set(size_t position) {
+        assert(position < _size);
+        _words[position / 64] |= uint64_t{1} << (position % 64);
+    }
+
+    // ors 64 bits into the bitmap, bit j of word is position 64 * index + j. Bits beyond size() have to be 0
+    void set_word(size_t index, uint64_t word) {
+        assert(index < _words.size());
+        _words[index] |= word;
+    }
+
+    size_t count() const {
+        size_t result = 0;
+        for (const auto word : _words) {
+            result += __builtin_popcountll(word);
+        }
+        return result;
+    }
+
+    std::vector<size_t> positions() const {
+        std::vector<size_t> result;
+        result.reserve(count());
+        for (size_t word_index = 0; word_index < _words.size(); word_index++) {
+            uint64_t word = _words[word_index];
+            while (word != 0) {
+                result.push_back(word_index * 64 + __builtin_ctzll(word));
+                word &= word - 1; // clear lowest set bit
+            }
+        }
+        return result;
+    }
+
+    Bitmap& operator&=(const Bitmap& other) {
+        assert(_size == other._size);
+        for (size_t i = 0; i < _words.size(); i++) {
+            _words[i] &= other._words[i];
+        }
+        return *this;
+    }
+
+    Bitmap& operator|=(const Bitmap& other) {
+        assert(_size == other._size);
+        for (size_t i = 0; i < _words.size(); i++) {
+            _words[i] |= other._words[i];
+        }
+        return *this;
+    }
+
+    friend Bitmap operator&(Bitmap lhs, const Bitmap& rhs) { return lhs &= rhs; }
+    friend Bitmap operator|(Bitmap lhs, const Bitmap& rhs) { return lhs |= rhs; }
+
+private:
+    std::vector<uint64_t> _words;
+    size_t _size;
+};
+
+template <typename T>
+class Bitpacker {
+
+public:
+    Bitpacker() : _state{0}, _state_bits_used{0}, _state_bits_max{8 * sizeof(_state)}, _num_unpacked_numbers {0} {}
+
+    /**
+     * With stats, pack_values, get_values and the scans record their time and sizes, and pack_values the bits
+     * the values need (log2 of their magnitude) and how many do not fit. Null (the default) turns it off.
+     */
+    void set_stats(codec_stats* stats) { _stats = stats; }
+
+    void add_value(const int64_t value, const size_t bits) {
+        assert(bits > 0);
+        // start with the most significant bit
+        for (size_t bit{bits}; bit > 0; bit--) {
+            const uint64_t bitmask = uint64_t{1} << (bit - 1);
+
+            _state = _state << 1; // Move state one bit left
+            _state_bits_used++;
+            if ((bitmask & value) != 0) {
+                // bit at position bit is 1, so we append 1
+                _state = _state | 1;
+            }
+
+            // check whether the buffer is full
+            if (_state_bits_used == _state_bits_max) {
+                _values.push_back(_state);
+                _state = 0;
+                _state_bits_used = 0;
+            }
+        }
+    }
+
+    /**
+     * Unpacks all values. Value i starts at bit i * bits, so the values are split into word aligned segments
+     * up front and each segment is decoded by its own thread straight into the preallocated result.
+     * @param bits width the values were packed with
+     * @param num_threads 0 = one thread per core
+     */
+    std::vector<int64_t> get_values(const size_t bits = 8 * sizeof(T), const size_t num_threads = 0) const {
+        assert(bits > 1 && bits <= 64);
+        // if the number of values was set too large (see read_binary), stop at the end of the packed data
+        const size_t num_values = std::min(_num_unpacked_numbers, _values.size() * WORD_BITS / bits);
+        const auto start = _stats ? stats_clock::now() : stats_clock::time_point{};
+        std::vector<int64_t> result(num_values);
+
+        for_each_segment(num_values, bits, num_threads, [&](const size_t first, const size_t last) {
+            const size_t first_word = first * bits / WORD_BITS;
+            bit_reader<T> reader(_values.data() + first_word, _values.data() + _values.size());
+            for (size_t i = first; i < last; i++) {
+                const uint64_t code = reader.read(bits);
+                // 2er complement: shift the sign bit of the code to bit 63 and back to sign extend it
+                result[i] = static_cast<int64_t>(code << (64 - bits)) >> (64 - bits);
+            }
+        });
+
+        if (_stats) {
+            _stats->add_stage("unpack", start, _values.size() * sizeof(T), num_values * sizeof(int64_t));
+        }
+        return result;
+    }
+
+    void flush() {
+        if (_state_bits_used > 0) {
+            _state = _state << (_state_bits_max - _state_bits_used);
+            _values.push_back(_state);
+            _state = 0;
+            _state_bits_used = 0;
+        }
+    }
+
+    void read_text(const std::string& filename, const size_t bits = 8 * sizeof(T)) {
+        std::ifstream file(filename, std::ios_base::in);
+        std::vector<int64_t> values;
+        int64_t number;
+        while (file >> number) {
+            values.push_back(number);
+        }
+        pack_values(values, bits);
+        file.close(); // should happen automatically once file goes out of scope?
+    }
+
+    /**
+     * Packs all values, replacing the current content. Like get_values, the input is split into word aligned
+     * segments, which are packed in parallel into the preallocated (zeroed) words.
+     * @param num_threads 0 = one thread per core
+     */
+    void pack_values(const std::vector<int64_t>& values, const size_t bits = 8 * sizeof(T), const size_t num_threads = 0) {
+        assert(bits > 0 && bits <= 64);
+        if (_stats) {
+            record_value_bits(values, bits);
+        }
+        const auto start = _stats ? stats_clock::now() : stats_clock::time_point{};
+        _values.assign((values.size() * bits + WORD_BITS - 1) / WORD_BITS, 0);
+        _state = 0;
+        _state_bits_used = 0;
+        _num_unpacked_numbers = values.size();
+
+        for_each_segment(values.size(), bits, num_threads, [&](const size_t first, const size_t last) {
+            const uint64_t code_mask = bits == 64 ? ~uint64_t{0} : (uint64_t{1} << bits) - 1;
+            size_t bit_position = first * bits;
+            for (size_t i = first; i < last; i++) {
+                write_code(static_cast<uint64_t>(values[i]) & code_mask, bits, bit_position);
+                bit_position += bits;
+            }
+        });
+
+        if (_stats) {
+            _stats->add_stage("pack", start, values.size() * sizeof(int64_t), _values.size() * sizeof(T));
+            _stats->count("values", values.size());
+        }
+    }
+
+    /*
+     * Predicate scans on the packed data. The values are never sign extended or written to a vector:
+     * each code is xor'ed with the sign bit, which maps the two's complement range [-2^(bits-1), 2^(bits-1))
+     * order-preserving onto [0, 2^bits), and compared there against the equally mapped bounds.
+     */
+    Bitmap scan_between(const int64_t lower, const int64_t upper, const size_t bits = 8 * sizeof(T)) const {
+        assert(bits > 1 && bits <= 64);
+        Bitmap result(_num_unpacked_numbers);
+        const int64_t min_value = bits == 64 ? INT64_MIN : -(int64_t{1} << (bits - 1));
+        const int64_t max_value = bits == 64 ? INT64_MAX : (int64_t{1} << (bits - 1)) - 1;
+        if (lower > upper || upper < min_value || lower > max_value) {
+            return result;
+        }
+        const uint64_t sign_bit = uint64_t{1} << (bits - 1);
+        const uint64_t biased_lower = static_cast<uint64_t>(std::max(lower, min_value)) ^ sign_bit;
+        const uint64_t biased_upper = static_cast<uint64_t>(std::min(upper, max_value)) ^ sign_bit;
+        // the bounds were sign extended, drop everything above the code width
+        const uint64_t code_mask = bits == 64 ? ~uint64_t{0} : (uint64_t{1} << bits) - 1;
+        const auto start = _stats ? stats_clock::now() : stats_clock::time_point{};
+        scan_codes(result, biased_lower & code_mask, biased_upper & code_mask, bits);
+        if (_stats) {
+            _stats->add_stage("scan", start, _values.size() * sizeof(T), (result.size() + 7) / 8);
+            _stats->count("scan_matches", result.count());
+        }
+        return result;
+    }
+
+    Bitmap scan_equal(const int64_t value, const size_t bits = 8 * sizeof(T)) const {
+        return scan_between(value, value, bits);
+    }
+
+    Bitmap scan_less(const int64_t value, const size_t bits = 8 * sizeof(T)) const {
+        if (value == INT64_MIN) {
+            return Bitmap(_num_unpacked_numbers);
+        }
+        return scan_between(INT64_MIN, value - 1, bits);
+    }
+
+    Bitmap scan_less_equal(const int64_t value, const size_t bits = 8 * sizeof(T)) const {
+        return scan_between(INT64_MIN, value, bits);
+    }
+
+    Bitmap scan_greater(const int64_t value, const size_t bits = 8 * sizeof(T)) const {
+        if (value == INT64_MAX) {
+            return Bitmap(_num_unpacked_numbers);
+        }
+        return scan_between(value + 1, INT64_MAX, bits);
+    }
+
+    Bitmap scan_greater_equal(const int64_t value, const size_t bits = 8 * sizeof(T)) const {
+        return scan_between(value, INT64_MAX, bits);
+    }
+
+    void write_text(const std::string& filename, size_t bits = 8 * sizeof(T)) {
+        std::ofstream file(filename, std::ios_base::out);
+        const auto values = get_values(bits);
+        for (const auto value : values) {
+            file << value << std::endl;
+            std::cout << value << " written" << std::endl;
+        }
+        file.close();
+    }
+
+    void read_binary(const std::string& filename,  size_t num_numbers) {
+        _values.clear();
+        std::ifstream file(filename, std::ios::binary);
+        char number;
+        while (file.read(&number, 1)) {
+            add_value(number, 8);
+        }
+        flush();
+        file.close(); // should happen automatically once file goes out of scope?
+        _num_unpacked_numbers = num_numbers;
+    }
+
+    // the packed words, e.g. to measure the packed size
+    const std::vector<T>& packed() const { return _values; }
+
+    void write_binary(const std::string& filename) {
+        std::ofstream file(filename, std::ios::out | std::ios::binary);
+        file.write((char*)&_values[0], _values.size() * sizeof(T));
+        file.close();
+    }
+
+private:
+    using U = std::make_unsigned_t<T>;
+    static constexpr size_t WORD_BITS = 8 * sizeof(T);
+    // below this many values per thread, starting a thread costs more than it saves
+    static constexpr size_t MIN_VALUES_PER_THREAD = 1 << 16;
+
+    /**
+     * Splits [0, num_values) into at most num_threads contiguous segments whose first value starts on a word
+     * boundary, and calls f(first, last) for each of them on its own thread. Segments never share a word, so
+     * the threads can write their words without synchronisation.
+     */
+    template <typename F>
+    static void for_each_segment(const size_t num_values, const size_t bits, size_t num_threads, F f) {
+        if (num_threads == 0) {
+            num_threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        num_threads = std::max<size_t>(1, std::min(num_threads, num_values / MIN_VALUES_PER_THREAD));
+
+        // the smallest number of values that fills a whole number of words: lcm(bits, WORD_BITS) / bits
+        const size_t values_per_block = WORD_BITS / std::gcd(bits, WORD_BITS);
+        const size_t num_blocks = (num_values + values_per_block - 1) / values_per_block;
+        const size_t values_per_segment = (num_blocks + num_threads - 1) / num_threads * values_per_block;
+
+        std::vector<std::thread> threads;
+        for (size_t first = values_per_segment; first < num_values; first += values_per_segment) {
+            threads.emplace_back(f, first, std::min(num_values, first + values_per_segment));
+        }
+        f(0, std::min(num_values, values_per_segment)); // the first segment runs on the calling thread
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
+
+    // histogram of the bits the magnitudes of the values need, and how many values need more than bits
+    void record_value_bits(const std::vector<int64_t>& values, const size_t bits) const {
+        log2_histogram magnitudes;
+        uint64_t truncated = 0;
+        const int64_t min_value = bits == 64 ? INT64_MIN : -(int64_t{1} << (bits - 1));
+        const int64_t max_value = bits == 64 ? INT64_MAX : (int64_t{1} << (bits - 1)) - 1;
+        for (const auto value : values) {
+            magnitudes.add(value < 0 ? ~static_cast<uint64_t>(value) : static_cast<uint64_t>(value));
+            truncated += value < min_value || value > max_value;
+        }
+        _stats->add_histogram("value_magnitude", magnitudes);
+        _stats->count("truncated_values", truncated);
+    }
+
+    // ors the code into the (zero initialised) words, most significant bit first, starting at bit_position
+    void write_code(const uint64_t code, size_t bits, const size_t bit_position) {
+        size_t word = bit_position / WORD_BITS;
+        size_t word_bits_free = WORD_BITS - bit_position % WORD_BITS;
+        while (bits > 0) {
+            const size_t take = std::min(bits, word_bits_free);
+            uint64_t chunk = code >> (bits - take);
+            if (take < 64) {
+                chunk &= (uint64_t{1} << take) - 1;
+            }
+            _values[word] = static_cast<T>(static_cast<U>(_values[word]) | static_cast<U>(chunk << (word_bits_free - take)));
+            bits -= take;
+            word++;
+            word_bits_free = WORD_BITS;
+        }
+    }
+
+    // 64 bits of the stream starting at bit 64 * chunk, which has to lie completely within the packed words
+    uint64_t load_chunk(const size_t chunk) const {
+        const T* words = _values.data() + chunk * 64 / WORD_BITS;
+        uint64_t result;
+        if constexpr (WORD_BITS == 64) {
+            result = static_cast<U>(words[0]);
+        } else if constexpr (WORD_BITS == 8) {
+            // the bytes are in stream order, a big endian load
+            std::memcpy(&result, words, sizeof(result));
+            result = __builtin_bswap64(result);
+        } else {
+            result = 0;
+            for (size_t i = 0; i < 64 / WORD_BITS; i++) {
+                result = (result << WORD_BITS) | static_cast<U>(words[i]);
+            }
+        }
+        return result;
+    }
+
+    static uint64_t reverse_bits(uint64_t x) {
+        x = __builtin_bswap64(x);
+        x = ((x >> 4) & 0x0F0F0F0F0F0F0F0Full) | ((x & 0x0F0F0F0F0F0F0F0Full) << 4);
+        x = ((x >> 2) & 0x3333333333333333ull) | ((x & 0x3333333333333333ull) << 2);
+        x = ((x >> 1) & 0x5555555555555555ull) | ((x & 0x5555555555555555ull) << 1);
+        return x;
+    }
+
+    /*
+     * Sets the bits of all codes in [lower, upper] (biased domain, both inclusive).
+     *
+     * The codes are compared where they are: a 64 bit window of the stream starting at a code holds
+     * k = 64 / bits whole codes as fields of a word, and all of them are compared at once (SWAR). Without a spare
+     * delimiter bit per field, a >= c is computed per field from the most significant bits H and the remaining
+     * bits: ((a | H) - (c & ~H)) has H set iff the remaining bits of a are >= those of c, and cannot borrow from
+     * the next field, so ge = (a & ~c | ~(a ^ c) & ((a | H) - (c & ~H))) & H.
+     * The H bits of the matches are then gathered into k adjacent bits, the first code of a window (its most
+     * significant field) at the lowest one. Above 32 bits a window holds a single code, compared directly.
+     */
+    void scan_codes(Bitmap& result, const uint64_t lower, const uint64_t upper, const size_t bits) const {
+        const size_t num_values = _num_unpacked_numbers;
+        const size_t k = 64 / bits;
+        const size_t unused_bits = 64 - k * bits; // below the last field
+        uint64_t field_ones = 0; // lowest bit of every field
+        for (size_t field = 0; field < k; field++) {
+            field_ones |= uint64_t{1} << (unused_bits + field * bits);
+        }
+        const uint64_t high_bits = field_ones << (bits - 1);
+        const uint64_t fields = bits == 64 ? ~uint64_t{0} : field_ones * ((uint64_t{1} << bits) - 1);
+        const uint64_t lowers = field_ones * lower;
+        const uint64_t uppers = field_ones * upper;
+        const auto greater_equal = [high_bits](const uint64_t a, const uint64_t c) {
+            return ((a & ~c) | (~(a ^ c) & ((a | high_bits) - (c & ~high_bits)))) & high_bits;
+        };
+        // After shifting the matches down, field f (counted from the lowest, code i + k - 1 - f) has its bit at f * bits.
+        // With bits >= k, one multiplication moves every field bit to bit 64 - 1 - f of the product: no two partial
+        // products land on the same bit, so there are no carries, and none but the wanted ones lands in the top k bits.
+        uint64_t gather_factor = 0;
+        for (size_t field = 0; bits >= k && field < k; field++) {
+            gather_factor |= uint64_t{1} << (64 - k + (k - 1 - field) - field * bits);
+        }
+        // Narrower codes are gathered in log2(k) steps, each merging groups of g bits at every g-th field into groups
+        // of 2g bits at every 2g-th field; the result is in field order and gets reversed
+        uint64_t gather_masks[6];
+        size_t num_steps = 0;
+        for (size_t group = 1; bits < k && group < k; group *= 2, num_steps++) {
+            uint64_t mask = 0;
+            for (size_t field = 0; field < k; field += 2 * group) {
+                mask |= ((uint64_t{1} << std::min(2 * group, k - field)) - 1) << (field * bits);
+            }
+            gather_masks[num_steps] = mask;
+        }
+
+        // windows are loaded from two 64 bit chunks of the stream, the last codes are read one by one.
+        // The selection is collected in a register and stored once per 64 codes: or-ing straight into the bitmap
+        // would make every window wait for the store of the previous one.
+        const size_t num_chunks = _values.size() * WORD_BITS / 64;
+        uint64_t selection = 0;
+        size_t i = 0;
+        for (size_t position = 0; i + k <= num_values && position / 64 + 2 <= num_chunks; i += k, position += k * bits) {
+            const size_t chunk = position / 64;
+            const size_t offset = position % 64;
+            // (x >> 1) >> (63 - offset) is 0 for offset 0, where x >> 64 would be undefined
+            const uint64_t window = (load_chunk(chunk) << offset) | ((load_chunk(chunk + 1) >> 1) >> (63 - offset));
+            const uint64_t codes = (window ^ high_bits) & fields;
+
+            // code i + j -> bit j
+            uint64_t selected;
+            if (k == 1) {
+                // a single code is compared directly, lower <= code <= upper as one unsigned comparison
+                selected = (codes >> unused_bits) - lower <= upper - lower;
+            } else if (bits >= k) {
+                const uint64_t matches = (greater_equal(codes, lowers) & greater_equal(uppers, codes)) >> (unused_bits + bits - 1);
+                selected = (matches * gather_factor) >> (64 - k);
+            } else {
+                uint64_t matches = (greater_equal(codes, lowers) & greater_equal(uppers, codes)) >> (unused_bits + bits - 1);
+                for (size_t step = 0, group = 1; step < num_steps; step++, group *= 2) {
+                    matches = (matches | (matches >> (group * bits - group))) & gather_masks[step];
+                }
+                selected = reverse_bits(matches) >> (64 - k);
+            }
+            const size_t shift = i % 64;
+            selection |= selected << shift;
+            if (shift + k >= 64) {
+                result.set_word(i / 64, selection);
+                selection = (selected >> 1) >> (63 - shift); // the bits that did not fit, 0 for shift 0
+            }
+        }
+        if (selection != 0) {
+            result.set_word(i / 64, selection);
+        }
+
+        if (i < num_values) {
+            bit_reader<T> reader(_values.data() + i * bits / WORD_BITS, _values.data() + _values.size());
+            if (i * bits % WORD_BITS != 0) {
+                reader.read(i * bits % WORD_BITS);
+            }
+            for (; i < num_values; i++) {
+                const uint64_t code = reader.read(bits) ^ (uint64_t{1} << (bits - 1));
+                if (code >= lower && code <= upper) {
+                    result.set(i);
+                }
+            }
+        }
+    }
+
+    std::vector<T> _values;
+    T _state;
+    size_t _state_bits_used;
+    size_t _num_unpacked_numbers;
+    const size_t _state_bits_max;
+    codec_stats* _stats = nullptr;
+
+};
@@ -0,0 +1,100 @@
+#include "bitpacking.hpp"
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// Compares the scans on packed values with a plain filter over the values, for several word types and widths.
+// Returns 1 if any result differs.
+
+namespace {
+
+size_t num_failures = 0;
+
+template <typename F>
+Bitmap filter(const std::vector<int64_t>& values, F predicate) {
+    Bitmap result(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        if (predicate(values[i])) {
+            result.set(i);
+        }
+    }
+    return result;
+}
+
+void check(const Bitmap& scanned, const Bitmap& expected, const std::string& what) {
+    if (scanned.size() != expected.size() || scanned.positions() != expected.positions()) {
+        std::cerr << "FAILED: " << what << ": " << scanned.count() << " matches instead of " << expected.count() << std::endl;
+        num_failures++;
+    }
+}
+
+template <typename T>
+void test_scans(const size_t bits, const size_t num_values, std::mt19937_64& rng) {
+    const int64_t min_value = bits == 64 ? INT64_MIN : -(int64_t{1} << (bits - 1));
+    const int64_t max_value = bits == 64 ? INT64_MAX : (int64_t{1} << (bits - 1)) - 1;
+    std::uniform_int_distribution<int64_t> random_value(min_value, max_value);
+    std::vector<int64_t> values(num_values);
+    for (auto& value : values) {
+        value = random_value(rng);
+    }
+    if (num_values > 2) {
+        values[0] = min_value;
+        values[num_values - 1] = max_value;
+    }
+    Bitpacker<T> packer;
+    packer.pack_values(values, bits);
+
+    const std::string name = std::to_string(8 * sizeof(T)) + " bit words, " + std::to_string(bits) + " bits, "
+        + std::to_string(num_values) + " values";
+    std::vector<int64_t> bounds = {min_value, max_value, 0, -1, 1, INT64_MIN, INT64_MAX};
+    for (int i = 0; i < 4; i++) {
+        bounds.push_back(random_value(rng));
+    }
+    for (const auto bound : bounds) {
+        const std::string with = name + ", bound " + std::to_string(bound);
+        check(packer.scan_less(bound, bits), filter(values, [&](int64_t v) { return v < bound; }), "scan_less, " + with);
+        check(packer.scan_less_equal(bound, bits), filter(values, [&](int64_t v) { return v <= bound; }), "scan_less_equal, " + with);
+        check(packer.scan_greater(bound, bits), filter(values, [&](int64_t v) { return v > bound; }), "scan_greater, " + with);
+        check(packer.scan_greater_equal(bound, bits), filter(values, [&](int64_t v) { return v >= bound; }), "scan_greater_equal, " + with);
+    }
+    // values from the data, so equality matches something
+    const int64_t present = num_values > 0 ? values[num_values / 2] : 0;
+    check(packer.scan_equal(present, bits), filter(values, [&](int64_t v) { return v == present; }), "scan_equal, " + name);
+    for (size_t i = 0; i + 1 < bounds.size(); i++) {
+        const int64_t lower = std::min(bounds[i], bounds[i + 1]);
+        const int64_t upper = std::max(bounds[i], bounds[i + 1]);
+        check(packer.scan_between(lower, upper, bits), filter(values, [&](int64_t v) { return v >= lower && v <= upper; }),
+              "scan_between " + std::to_string(lower) + " " + std::to_string(upper) + ", " + name);
+    }
+
+    // combined selections, e.g. a range as two scans, or its complement
+    const int64_t a = random_value(rng), b = random_value(rng);
+    const int64_t lower = std::min(a, b), upper = std::max(a, b);
+    check(packer.scan_greater_equal(lower, bits) & packer.scan_less_equal(upper, bits),
+          filter(values, [&](int64_t v) { return v >= lower && v <= upper; }), "& of two scans, " + name);
+    check(packer.scan_less(lower, bits) | packer.scan_greater(upper, bits),
+          filter(values, [&](int64_t v) { return v < lower || v > upper; }), "| of two scans, " + name);
+}
+
+}
+
+int main() {
+    std::mt19937_64 rng(26);
+    for (const size_t bits : {2, 3, 6, 7, 8, 13, 15, 16, 31, 32, 33, 63, 64}) {
+        // lengths around the window and word boundaries, and one long enough for several bitmap words
+        for (const size_t num_values : {0, 1, 7, 64, 65, 1000, 10007}) {
+            test_scans<int8_t>(bits, num_values, rng);
+            test_scans<int16_t>(bits, num_values, rng);
+            test_scans<int64_t>(bits, num_values, rng);
+        }
+    }
+    if (num_failures > 0) {
+        std::cerr << num_failures << " scans failed" << std::endl;
+        return 1;
+    }
+    std::cout << "all scans match" << std::endl;
+    return 0;
+}
@@ -0,0 +1,238 @@
+#include "adaptive.h"
+#include "lz78decode.hpp"
+#include "lz78encode.hpp"
+#include "memory_stream.h"
+#include "packbits.hpp"
+#include "snappy.hpp"
+
+#include <array>
+#include <cmath>
+#include <string>
+#include <vector>
+
+namespace {
+
+constexpr size_t HEADER_BYTES = 9;
+constexpr size_t NUM_CODECS = 4;
+constexpr size_t NUM_SLICES = 4;
+// a block above this entropy (bits per byte) and with hardly any runs is stored without trying the codecs
+constexpr double RANDOM_ENTROPY = 7.9;
+constexpr double RANDOM_RUN_FRACTION = 0.01;
+// codes must be at least this much smaller than the block, or it is stored
+constexpr double MIN_RATIO = 1.01;
+
+// from the cheapest to the most expensive
+constexpr std::array<block_codec, 3> CANDIDATES{block_codec::packbits, block_codec::snappy, block_codec::lz78};
+
+const char* codec_name(block_codec codec) {
+    static const char* const names[NUM_CODECS] = {"stored", "packbits", "snappy", "lz78"};
+    return names[static_cast<size_t>(codec)];
+}
+
+// appends the codes of data to out
+bool encode(block_codec codec, const uint8_t* data, size_t size, int lz78_maxbits, std::vector<uint8_t>& out) {
+    memory_istreambuf inbuf(data, size);
+    vector_ostreambuf outbuf(out);
+    std::istream is(&inbuf);
+    std::ostream os(&outbuf);
+    switch (codec) {
+        case block_codec::stored:
+            out.insert(out.end(), data, data + size);
+            return true;
+        case block_codec::packbits:
+            packbits_compress(is, os);
+            return true;
+        case block_codec::snappy:
+            return snappy_compress(is, os);
+        case block_codec::lz78:
+            return lz78encode(is, os, lz78_maxbits);
+    }
+    return false;
+}
+
+// appends the bytes of the codes to out
+bool decode(block_codec codec, const uint8_t* codes, size_t size, std::vector<uint8_t>& out) {
+    memory_istreambuf inbuf(codes, size);
+    vector_ostreambuf outbuf(out);
+    std::istream is(&inbuf);
+    std::ostream os(&outbuf);
+    switch (codec) {
+        case block_codec::stored:
+            out.insert(out.end(), codes, codes + size);
+            return true;
+        case block_codec::packbits:
+            packbits_decompress(is, os);
+            return true;
+        case block_codec::snappy:
+            return snappy_decompress(is, os);
+        case block_codec::lz78:
+            return lz78decode(is, os);
+    }
+    return false;
+}
+
+// order 0 entropy in bits per byte, and the fraction of bytes equal to their predecessor
+struct block_profile
+{
+    double entropy;
+    double run_fraction;
+};
+
+block_profile profile(const uint8_t* data, size_t size) {
+    std::array<size_t, 256> counts{};
+    size_t repeats = 0;
+    for (size_t i = 0; i < size; i++) {
+        counts[data[i]]++;
+        repeats += i > 0 && data[i] == data[i - 1];
+    }
+    double entropy = 0;
+    for (const size_t count : counts) {
+        if (count > 0) {
+            const double p = static_cast<double>(count) / size;
+            entropy -= p * std::log2(p);
+        }
+    }
+    return {entropy, static_cast<double>(repeats) / size};
+}
+
+// NUM_SLICES slices spread evenly over the block, together sample_bytes long
+void take_sample(const uint8_t* data, size_t size, size_t sample_bytes, std::vector<uint8_t>& sample) {
+    sample.clear();
+    if (size <= sample_bytes) {
+        sample.assign(data, data + size);
+        return;
+    }
+    const size_t slice = sample_bytes / NUM_SLICES;
+    for (size_t i = 0; i < NUM_SLICES; i++) {
+        const size_t offset = i * (size - slice) / (NUM_SLICES - 1);
+        sample.insert(sample.end(), data + offset, data + offset + slice);
+    }
+}
+
+block_codec choose_codec(const uint8_t* data, size_t size, const adaptive_options& options, std::vector<uint8_t>& sample,
+                         std::vector<uint8_t>& scratch) {
+    const auto p = profile(data, size);
+    if (p.entropy > RANDOM_ENTROPY && p.run_fraction < RANDOM_RUN_FRACTION) {
+        return block_codec::stored;
+    }
+
+    take_sample(data, size, options.sample_bytes, sample);
+    block_codec best = block_codec::stored;
+    double best_ratio = MIN_RATIO;
+    for (const auto codec : CANDIDATES) {
+        scratch.clear();
+        if (!encode(codec, sample.data(), sample.size(), options.lz78_maxbits, scratch)) {
+            continue;
+        }
+        const double ratio = static_cast<double>(sample.size()) / scratch.size();
+        if (ratio >= options.target_ratio) {
+            return codec;
+        }
+        if (ratio > best_ratio) {
+            best = codec;
+            best_ratio = ratio;
+        }
+    }
+    return best;
+}
+
+void put_u32(uint8_t* out, uint32_t value) {
+    for (size_t i = 0; i < 4; i++) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t get_u32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (size_t i = 0; i < 4; i++) {
+        value |= static_cast<uint32_t>(in[i]) << (8 * i);
+    }
+    return value;
+}
+
+}
+
+bool adaptive_compress(std::istream& is, std::ostream& os, const adaptive_options& options, codec_stats* stats) {
+    if (options.block_bytes == 0 || options.block_bytes > MAX_BLOCK_BYTES) {
+        return false;
+    }
+    std::vector<uint8_t> block(options.block_bytes), codes, sample, scratch;
+    std::array<uint64_t, NUM_CODECS> num_blocks{}, raw_bytes{};
+    while (is) {
+        is.read(reinterpret_cast<char*>(block.data()), block.size());
+        const size_t size = is.gcount();
+        if (size == 0) {
+            break;
+        }
+
+        auto start = stats ? stats_clock::now() : stats_clock::time_point{};
+        block_codec codec = choose_codec(block.data(), size, options, sample, scratch);
+        if (stats) {
+            stats->add_stage("select", start, size, 0);
+            start = stats_clock::now();
+        }
+
+        codes.assign(HEADER_BYTES, 0);
+        if (codec != block_codec::stored
+            && (!encode(codec, block.data(), size, options.lz78_maxbits, codes) || codes.size() - HEADER_BYTES >= size)) {
+            codec = block_codec::stored;
+            codes.resize(HEADER_BYTES);
+        }
+        if (codec == block_codec::stored) {
+            codes.insert(codes.end(), block.data(), block.data() + size);
+        }
+        codes[0] = static_cast<uint8_t>(codec);
+        put_u32(codes.data() + 1, size);
+        put_u32(codes.data() + 5, codes.size() - HEADER_BYTES);
+        os.write(reinterpret_cast<const char*>(codes.data()), codes.size());
+
+        if (stats) {
+            stats->add_stage("encode", start, size, codes.size());
+            num_blocks[static_cast<size_t>(codec)]++;
+            raw_bytes[static_cast<size_t>(codec)] += size;
+        }
+    }
+
+    if (stats) {
+        for (size_t codec = 0; codec < NUM_CODECS; codec++) {
+            const std::string name = codec_name(static_cast<block_codec>(codec));
+            stats->count("blocks_" + name, num_blocks[codec]);
+            stats->count("raw_bytes_" + name, raw_bytes[codec]);
+        }
+    }
+    return is.eof() && os;
+}
+
+bool adaptive_decompress(std::istream& is, std::ostream& os, codec_stats* stats) {
+    std::array<uint8_t, HEADER_BYTES> header;
+    std::vector<uint8_t> codes, block;
+    while (is.read(reinterpret_cast<char*>(header.data()), header.size())) {
+        const auto start = stats ? stats_clock::now() : stats_clock::time_point{};
+        if (header[0] >= NUM_CODECS) {
+            return false;
+        }
+        const auto codec = static_cast<block_codec>(header[0]);
+        const uint32_t raw_size = get_u32(header.data() + 1);
+        const uint32_t coded_size = get_u32(header.data() + 5);
+        // adaptive_compress stores every block its codec does not shrink
+        if (raw_size > MAX_BLOCK_BYTES || coded_size > raw_size || (codec != block_codec::stored && coded_size == raw_size)) {
+            return false;
+        }
+        codes.resize(coded_size);
+        if (!is.read(reinterpret_cast<char*>(codes.data()), codes.size())) {
+            return false;
+        }
+        block.clear();
+        if (!decode(codec, codes.data(), codes.size(), block) || block.size() != raw_size) {
+            return false;
+        }
+        os.write(reinterpret_cast<const char*>(block.data()), block.size());
+
+        if (stats) {
+            stats->add_stage("decode", start, HEADER_BYTES + codes.size(), block.size());
+            stats->count(std::string("blocks_") + codec_name(codec), 1);
+        }
+    }
+    // a partial header is a truncated block
+    return is.gcount() == 0 && os;
+}
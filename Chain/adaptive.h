@@ -0,0 +1,35 @@
+#pragma once
+
+#include "codec_stats.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+// codec of a block, stored in its header
+enum class block_codec : uint8_t { stored = 0, packbits = 1, snappy = 2, lz78 = 3 };
+
+// largest block (before coding) adaptive_decompress accepts, so a corrupt header cannot ask for any amount of memory
+constexpr size_t MAX_BLOCK_BYTES = 1 << 26;
+
+struct adaptive_options
+{
+    double target_ratio = 2.0;    // the first (cheapest) codec reaching this ratio on the sample is taken
+    size_t block_bytes = 1 << 16; // at most MAX_BLOCK_BYTES
+    size_t sample_bytes = 4096;   // taken in 4 slices spread over the block
+    int lz78_maxbits = 12;
+};
+
+/*
+ * Compresses the stream block by block, each block with the codec picked for it. The codecs are tried on a
+ * sample of the block from the cheapest (PackBits) to the most expensive (LZ78); nearly random blocks skip the
+ * trials. If no codec reaches the target ratio the one with the best ratio is used, and a block that does not
+ * shrink is stored. Every block is written as [codec: 1 byte][raw size: 4 bytes LE][coded size: 4 bytes LE][codes].
+ * With stats, the number of blocks and bytes per codec are recorded.
+ */
+bool adaptive_compress(std::istream& is, std::ostream& os, const adaptive_options& options = {}, codec_stats* stats = nullptr);
+
+// Expands the blocks of adaptive_compress, false on a truncated block, an unknown codec, a block larger than
+// MAX_BLOCK_BYTES, codes not smaller than their block (unless stored) or a size mismatch.
+bool adaptive_decompress(std::istream& is, std::ostream& os, codec_stats* stats = nullptr);
@@ -0,0 +1,307 @@
+#include "adaptive.h"
+#include "bitpacking.hpp"
+#include "codec_stats.hpp"
+#include "lz78decode.hpp"
+#include "lz78encode.hpp"
+#include "packbits.hpp"
+#include "queue_stream.h"
+#include "snappy.hpp"
+
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Chain [--stats|--stats=hw] <stage>[|<stage>...] <input or -> <output or ->
+// Runs the stages as one pipeline in memory, e.g. "packbits|snappy" or "delta|bitpack:8". Every stage runs on its
+// own thread and hands its output on in chunks through a bounded queue, so a chain reads its input and writes
+// its output once, whatever the number of stages.
+// Stages: packbits, unpackbits, snappy, unsnappy, lz78[:maxbits], unlz78, delta, undelta, bitpack[:bits],
+// auto[:target ratio] (a codec per block, see adaptive.h), unauto
+
+namespace {
+
+constexpr size_t QUEUE_CAPACITY = 4; // chunks in flight between two stages
+
+using stage_function = std::function<bool(std::istream& is, std::ostream& os, codec_stats* stats)>;
+
+struct stage
+{
+    std::string name;
+    stage_function run;
+};
+
+// text numbers -> differences to the previous number (the first one to 0), small for sorted input. The
+// arithmetic wraps around like unsigned numbers, so the differences of any two int64 values round-trip.
+bool delta_encode(std::istream& is, std::ostream& os) {
+    int64_t prev = 0, value;
+    while (is >> value) {
+        os << static_cast<int64_t>(static_cast<uint64_t>(value) - static_cast<uint64_t>(prev)) << '\n';
+        prev = value;
+    }
+    return is.eof();
+}
+
+bool delta_decode(std::istream& is, std::ostream& os) {
+    int64_t sum = 0, delta;
+    while (is >> delta) {
+        sum = static_cast<int64_t>(static_cast<uint64_t>(sum) + static_cast<uint64_t>(delta));
+        os << sum << '\n';
+    }
+    return is.eof();
+}
+
+// text numbers -> the words of Bitpacker, bits each in two's complement. Fails without writing anything if a
+// value does not fit.
+bool bitpack(std::istream& is, std::ostream& os, size_t bits, codec_stats* stats) {
+    const int64_t max_value = bits == 64 ? INT64_MAX : (int64_t{1} << (bits - 1)) - 1;
+    const int64_t min_value = -max_value - 1;
+    std::vector<int64_t> values;
+    int64_t value;
+    while (is >> value) {
+        if (value < min_value || value > max_value) {
+            std::cerr << "bitpack: " << value << " does not fit in " << bits << " bits" << std::endl;
+            return false;
+        }
+        values.push_back(value);
+    }
+    Bitpacker<int8_t> packer;
+    packer.set_stats(stats);
+    packer.pack_values(values, bits);
+    os.write(reinterpret_cast<const char*>(packer.packed().data()), packer.packed().size());
+    return is.eof() && os;
+}
+
+// the whole text as number, unlike atoi/atof, which would take "abc" as 0 and "8junk" as 8
+bool parse_number(const std::string& text, int& value) {
+    char* end;
+    errno = 0;
+    const long number = std::strtol(text.c_str(), &end, 10);
+    if (text.empty() || std::isspace(static_cast<unsigned char>(text[0])) || *end != '\0' || errno == ERANGE
+        || number < INT_MIN || number > INT_MAX) {
+        return false;
+    }
+    value = static_cast<int>(number);
+    return true;
+}
+
+bool parse_number(const std::string& text, double& value) {
+    char* end;
+    errno = 0;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && !std::isspace(static_cast<unsigned char>(text[0])) && *end == '\0' && errno != ERANGE;
+}
+
+// "name" or "name:parameter", false for unknown stages or bad parameters
+bool parse_stage(const std::string& spec, stage& result) {
+    const size_t colon = spec.find(':');
+    const std::string name = spec.substr(0, colon);
+    const bool has_parameter = colon != std::string::npos;
+    const std::string parameter = has_parameter ? spec.substr(colon + 1) : std::string();
+    if (has_parameter && name != "lz78" && name != "auto" && name != "bitpack") {
+        return false;
+    }
+    result.name = spec;
+    if (name == "packbits") {
+        result.run = [](std::istream& is, std::ostream& os, codec_stats* stats) {
+            packbits_compress(is, os, stats);
+            return true;
+        };
+    } else if (name == "unpackbits") {
+        result.run = [](std::istream& is, std::ostream& os, codec_stats* stats) {
+            packbits_decompress(is, os, stats);
+            return true;
+        };
+    } else if (name == "snappy") {
+        result.run = [](std::istream& is, std::ostream& os, codec_stats*) { return snappy_compress(is, os); };
+    } else if (name == "unsnappy") {
+        result.run = [](std::istream& is, std::ostream& os, codec_stats* stats) { return snappy_decompress(is, os, stats); };
+    } else if (name == "lz78") {
+        int maxbits = 16;
+        if ((has_parameter && !parse_number(parameter, maxbits)) || maxbits < 1 || maxbits > 31) {
+            return false;
+        }
+        result.run = [maxbits](std::istream& is, std::ostream& os, codec_stats* stats) {
+            return lz78encode(is, os, maxbits, stats);
+        };
+    } else if (name == "unlz78") {
+        result.run = [](std::istream& is, std::ostream& os, codec_stats*) { return lz78decode(is, os); };
+    } else if (name == "auto") {
+        adaptive_options options;
+        if ((has_parameter && !parse_number(parameter, options.target_ratio)) || !(options.target_ratio > 0)) {
+            return false;
+        }
+        result.run = [options](std::istream& is, std::ostream& os, codec_stats* stats) {
+            return adaptive_compress(is, os, options, stats);
+        };
+    } else if (name == "unauto") {
+        result.run = [](std::istream& is, std::ostream& os, codec_stats* stats) { return adaptive_decompress(is, os, stats); };
+    } else if (name == "delta") {
+        result.run = [](std::istream& is, std::ostream& os, codec_stats*) { return delta_encode(is, os); };
+    } else if (name == "undelta") {
+        result.run = [](std::istream& is, std::ostream& os, codec_stats*) { return delta_decode(is, os); };
+    } else if (name == "bitpack") {
+        int bits = 8;
+        if ((has_parameter && !parse_number(parameter, bits)) || bits < 1 || bits > 64) {
+            return false;
+        }
+        result.run = [bits](std::istream& is, std::ostream& os, codec_stats* stats) { return bitpack(is, os, bits, stats); };
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// the input in chunks of CHUNK_BYTES, false on a read error
+bool read_chunks(std::istream& is, chunk_queue& out) {
+    while (true) {
+        chunk data(CHUNK_BYTES);
+        is.read(reinterpret_cast<char*>(data.data()), data.size());
+        data.resize(is.gcount());
+        if (!data.empty()) {
+            out.push(std::move(data));
+        }
+        if (!is) {
+            break;
+        }
+    }
+    out.close();
+    return is.eof();
+}
+
+bool write_chunks(chunk_queue& in, std::ostream& os) {
+    chunk data;
+    while (in.pop(data)) {
+        os.write(reinterpret_cast<const char*>(data.data()), data.size());
+    }
+    return static_cast<bool>(os.flush());
+}
+
+// runs s between two queues, whatever happens (also an exception, e.g. on corrupt input) the input is drained
+// and the output closed
+void run_stage(const stage& s, chunk_queue& in, chunk_queue& out, codec_stats* stats, bool& ok) {
+    queue_istreambuf inbuf(in);
+    queue_ostreambuf outbuf(out);
+    std::istream is(&inbuf);
+    std::ostream os(&outbuf);
+    const auto start = stats ? stats_clock::now() : stats_clock::time_point{};
+    try {
+        ok = s.run(is, os, stats);
+    } catch (const std::exception& e) {
+        std::cerr << "Stage " << s.name << ": " << e.what() << std::endl;
+        ok = false;
+    }
+    inbuf.drain();
+    outbuf.close();
+    if (stats) {
+        stats->add_stage("chain", start, inbuf.num_bytes(), outbuf.num_bytes());
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    stats_mode mode = stats_mode::off;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        if (!parse_stats_option(argv[i], mode)) {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() != 3) {
+        std::cerr << "Usage: " << argv[0] << " [--stats|--stats=hw] <stage>[|<stage>...] <input or -> <output or ->" << std::endl;
+        return 1;
+    }
+
+    std::vector<stage> stages;
+    for (size_t begin = 0; begin <= args[0].size();) {
+        const size_t end = std::min(args[0].find('|', begin), args[0].size());
+        stage s;
+        if (!parse_stage(args[0].substr(begin, end - begin), s)) {
+            std::cerr << "Unknown stage or bad parameter: " << args[0].substr(begin, end - begin) << std::endl;
+            return 1;
+        }
+        stages.push_back(std::move(s));
+        begin = end + 1;
+    }
+
+    std::ifstream input_file;
+    std::ofstream output_file;
+    if (args[1] != "-") {
+        input_file.open(args[1], std::ios::binary);
+        if (!input_file) {
+            std::cerr << "Cannot open input file " << args[1] << std::endl;
+            return 1;
+        }
+    }
+    if (args[2] != "-") {
+        output_file.open(args[2], std::ios::binary);
+        if (!output_file) {
+            std::cerr << "Cannot open output file " << args[2] << std::endl;
+            return 1;
+        }
+    }
+    std::istream& is = args[1] == "-" ? std::cin : input_file;
+    std::ostream& os = args[2] == "-" ? std::cout : output_file;
+
+    // queue i feeds stage i, the last one the output
+    std::vector<std::unique_ptr<chunk_queue>> queues;
+    for (size_t i = 0; i <= stages.size(); i++) {
+        queues.push_back(std::make_unique<chunk_queue>(QUEUE_CAPACITY));
+    }
+    // complete before the threads start, they keep pointers into it
+    std::vector<std::unique_ptr<codec_stats>> stats;
+    for (const auto& s : stages) {
+        stats.push_back(make_codec_stats(s.name, mode));
+    }
+    std::vector<char> stage_ok(stages.size(), false);
+    std::vector<std::thread> threads;
+    bool read_ok = false;
+    threads.emplace_back([&] { read_ok = read_chunks(is, *queues[0]); });
+    for (size_t i = 0; i < stages.size(); i++) {
+        threads.emplace_back([&, i, stage_stats = stats[i].get()] {
+            bool ok;
+            run_stage(stages[i], *queues[i], *queues[i + 1], stage_stats, ok);
+            stage_ok[i] = ok;
+        });
+    }
+    const bool write_ok = write_chunks(*queues.back(), os);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    if (mode != stats_mode::off) {
+        std::cerr << "[" << std::endl;
+        for (size_t i = 0; i < stats.size(); i++) {
+            if (i > 0) {
+                std::cerr << "," << std::endl;
+            }
+            stats[i]->write_json(std::cerr);
+        }
+        std::cerr << "]" << std::endl;
+    }
+
+    bool ok = read_ok && write_ok;
+    if (!read_ok) {
+        std::cerr << "Cannot read " << args[1] << std::endl;
+    }
+    for (size_t i = 0; i < stages.size(); i++) {
+        if (!stage_ok[i]) {
+            std::cerr << "Stage " << stages[i].name << " failed" << std::endl;
+            ok = false;
+        }
+    }
+    if (!write_ok) {
+        std::cerr << "Cannot write " << args[2] << std::endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <vector>
+
+// Reads a buffer in place, so a block in memory can be given to the stream codecs without copying it.
+class memory_istreambuf : public std::streambuf
+{
+public:
+    memory_istreambuf(const uint8_t* data, size_t size) {
+        char* begin = const_cast<char*>(reinterpret_cast<const char*>(data));
+        setg(begin, begin, begin + size);
+    }
+};
+
+// Appends everything written to a vector.
+class vector_ostreambuf : public std::streambuf
+{
+    std::vector<uint8_t>& out_;
+
+protected:
+    int_type overflow(int_type c) override {
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            out_.push_back(static_cast<uint8_t>(traits_type::to_char_type(c)));
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override {
+        out_.insert(out_.end(), s, s + n);
+        return n;
+    }
+
+public:
+    explicit vector_ostreambuf(std::vector<uint8_t>& out) : out_(out) {}
+};
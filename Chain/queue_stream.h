@@ -0,0 +1,101 @@
+#pragma once
+
+#include "bounded_queue.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <streambuf>
+#include <utility>
+#include <vector>
+
+// Stages hand their output on in chunks of this size, moved through the queue without copying.
+constexpr size_t CHUNK_BYTES = 1 << 16;
+
+using chunk = std::vector<uint8_t>;
+using chunk_queue = bounded_queue<chunk>;
+
+// Reading end of a chunk queue: the get area is the chunk popped last, so the stream reads straight from it.
+class queue_istreambuf : public std::streambuf
+{
+    chunk_queue& queue_;
+    chunk current_;
+    size_t num_bytes_ = 0;
+
+protected:
+    int_type underflow() override {
+        while (gptr() == egptr()) {
+            if (!queue_.pop(current_)) {
+                return traits_type::eof();
+            }
+            num_bytes_ += current_.size();
+            char* begin = reinterpret_cast<char*>(current_.data());
+            setg(begin, begin, begin + current_.size());
+        }
+        return traits_type::to_int_type(*gptr());
+    }
+
+public:
+    explicit queue_istreambuf(chunk_queue& queue) : queue_(queue) {}
+
+    // bytes popped so far
+    size_t num_bytes() const { return num_bytes_; }
+
+    // pops the chunks nobody is going to read, so the producer is not blocked on a full queue
+    void drain() {
+        setg(nullptr, nullptr, nullptr);
+        while (queue_.pop(current_)) {
+        }
+    }
+};
+
+// Writing end of a chunk queue: the put area is a chunk of CHUNK_BYTES, pushed when it is full or on flush.
+class queue_ostreambuf : public std::streambuf
+{
+    chunk_queue& queue_;
+    chunk current_;
+    size_t num_bytes_ = 0;
+
+    void reset() {
+        current_.resize(CHUNK_BYTES);
+        char* begin = reinterpret_cast<char*>(current_.data());
+        setp(begin, begin + current_.size());
+    }
+
+    void push() {
+        const size_t num_bytes = pptr() - pbase();
+        if (num_bytes > 0) {
+            num_bytes_ += num_bytes;
+            current_.resize(num_bytes);
+            queue_.push(std::move(current_));
+            current_ = chunk();
+            reset();
+        }
+    }
+
+protected:
+    int_type overflow(int_type c) override {
+        push();
+        if (!traits_type::eq_int_type(c, traits_type::eof())) {
+            *pptr() = traits_type::to_char_type(c);
+            pbump(1);
+        }
+        return traits_type::not_eof(c);
+    }
+
+    int sync() override {
+        push();
+        return 0;
+    }
+
+public:
+    explicit queue_ostreambuf(chunk_queue& queue) : queue_(queue) { reset(); }
+
+    // bytes pushed so far
+    size_t num_bytes() const { return num_bytes_; }
+
+    // pushes what is left and tells the consumer that nothing follows
+    void close() {
+        push();
+        queue_.close();
+    }
+};
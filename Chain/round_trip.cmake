@@ -0,0 +1,18 @@
+# Chain check run by ctest:
+# cmake -DCHAIN=<Chain> -DSTAGES=<stages> -DINPUT=<file> -DWORK=<dir> [-DEXPECTED=<file>] -P round_trip.cmake
+# Runs the chain STAGES on INPUT, its output has to be identical to EXPECTED. Without EXPECTED the chain has to undo
+# itself, e.g. "lz78|unlz78", and reproduce INPUT.
+
+if (NOT DEFINED EXPECTED)
+    set(EXPECTED ${INPUT})
+endif ()
+file(MAKE_DIRECTORY ${WORK})
+
+execute_process(COMMAND ${CHAIN} ${STAGES} ${INPUT} ${WORK}/output RESULT_VARIABLE result ERROR_VARIABLE error)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "Chain ${STAGES} failed on ${INPUT} (${result}): ${error}")
+endif ()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${EXPECTED} ${WORK}/output RESULT_VARIABLE result)
+if (NOT result EQUAL 0)
+    message(FATAL_ERROR "Chain ${STAGES} on ${INPUT}: the output differs from ${EXPECTED}")
+endif ()
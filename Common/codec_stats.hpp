@@ -0,0 +1,237 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Opt-in instrumentation of the codecs (--stats). The codecs take a codec_stats* that is null by default and
+ * instantiate their hot loops once with and once without recording, so nothing is counted or timed when it is
+ * null. Everything collected is written as one JSON object, usually to stderr.
+ */
+
+using stats_clock = std::chrono::steady_clock;
+
+// counts of values in power of two buckets: bucket 0 holds 0, bucket i holds [2^(i-1), 2^i)
+class log2_histogram {
+    std::array<uint64_t, 65> _buckets{};
+
+public:
+    void add(uint64_t value) {
+        _buckets[value == 0 ? 0 : 64 - __builtin_clzll(value)]++;
+    }
+
+    log2_histogram& operator+=(const log2_histogram& other) {
+        for (size_t i = 0; i < _buckets.size(); i++) {
+            _buckets[i] += other._buckets[i];
+        }
+        return *this;
+    }
+
+    // [{"min": 4, "max": 7, "count": 12}, ...], empty buckets are left out
+    void write_json(std::ostream& os) const {
+        os << "[";
+        bool first = true;
+        for (size_t i = 0; i < _buckets.size(); i++) {
+            if (_buckets[i] == 0) {
+                continue;
+            }
+            const uint64_t min = i == 0 ? 0 : uint64_t{1} << (i - 1);
+            const uint64_t max = i == 0 ? 0 : (i == 64 ? UINT64_MAX : (uint64_t{1} << i) - 1);
+            os << (first ? "" : ", ") << "{\"min\": " << min << ", \"max\": " << max << ", \"count\": " << _buckets[i] << "}";
+            first = false;
+        }
+        os << "]";
+    }
+};
+
+/*
+ * Hardware counters through perf_event_open. They count in user space from start() on, for the calling thread
+ * and the threads it starts afterwards (their counts are added when they exit).
+ */
+class perf_counters {
+    static constexpr size_t NUM_EVENTS = 4;
+    static constexpr std::array<const char*, NUM_EVENTS> NAMES{"cycles", "instructions", "cache_misses", "branch_misses"};
+    std::array<int, NUM_EVENTS> _fds{-1, -1, -1, -1};
+
+    void close_all() {
+#ifdef __linux__
+        for (auto& fd : _fds) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            fd = -1;
+        }
+#endif
+    }
+
+public:
+    perf_counters() = default;
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+    ~perf_counters() { close_all(); }
+
+    // false if the counters are not available (no PMU, perf_event_paranoid, not Linux)
+    bool start() {
+#ifdef __linux__
+        constexpr std::array<uint64_t, NUM_EVENTS> configs{PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                                                           PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+        for (size_t i = 0; i < NUM_EVENTS; i++) {
+            perf_event_attr attr{};
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.size = sizeof(attr);
+            attr.config = configs[i];
+            attr.inherit = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            _fds[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+            if (_fds[i] < 0) {
+                close_all();
+                return false;
+            }
+        }
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    bool running() const { return _fds[0] >= 0; }
+
+    // {"cycles": n, ...} with the counts so far
+    void write_json(std::ostream& os) const {
+        os << "{";
+        for (size_t i = 0; i < NUM_EVENTS; i++) {
+            uint64_t value = 0;
+#ifdef __linux__
+            if (read(_fds[i], &value, sizeof(value)) != sizeof(value)) {
+                value = 0;
+            }
+#endif
+            os << (i == 0 ? "" : ", ") << "\"" << NAMES[i] << "\": " << value;
+        }
+        os << "}";
+    }
+};
+
+/*
+ * Numbers collected for one run of a codec: the wall time and bytes of its stages, named counters and
+ * histograms, and optionally the hardware counters. Codecs running on several threads can report concurrently.
+ */
+class codec_stats {
+    struct stage {
+        std::string name;
+        double seconds;
+        uint64_t bytes_in, bytes_out;
+    };
+
+    std::string _codec;
+    std::vector<stage> _stages; // in the order they were first reported
+    std::map<std::string, uint64_t> _counters;
+    std::map<std::string, log2_histogram> _histograms;
+    perf_counters _perf;
+    bool _hardware;
+    mutable std::mutex _mutex;
+
+public:
+    // with hardware, the hardware counters start right away
+    explicit codec_stats(std::string codec, bool hardware = false) : _codec{std::move(codec)}, _hardware{hardware} {
+        if (_hardware) {
+            _perf.start();
+        }
+    }
+
+    // adds the time since start and the bytes to the stage, stages reported several times are summed up
+    void add_stage(const std::string& name, stats_clock::time_point start, uint64_t bytes_in, uint64_t bytes_out) {
+        const double seconds = std::chrono::duration<double>(stats_clock::now() - start).count();
+        std::lock_guard lock(_mutex);
+        auto it = std::find_if(_stages.begin(), _stages.end(), [&](const stage& s) { return s.name == name; });
+        if (it == _stages.end()) {
+            _stages.push_back({name, seconds, bytes_in, bytes_out});
+        } else {
+            it->seconds += seconds;
+            it->bytes_in += bytes_in;
+            it->bytes_out += bytes_out;
+        }
+    }
+
+    void count(const std::string& name, uint64_t n) {
+        std::lock_guard lock(_mutex);
+        _counters[name] += n;
+    }
+
+    void add_histogram(const std::string& name, const log2_histogram& histogram) {
+        std::lock_guard lock(_mutex);
+        _histograms[name] += histogram;
+    }
+
+    void write_json(std::ostream& os) const {
+        std::lock_guard lock(_mutex);
+        os << "{\n\"codec\": \"" << _codec << "\",\n\"stages\": [";
+        for (size_t i = 0; i < _stages.size(); i++) {
+            const auto& s = _stages[i];
+            os << (i == 0 ? "\n" : ",\n") << "  {\"name\": \"" << s.name << "\", \"seconds\": " << s.seconds
+               << ", \"bytes_in\": " << s.bytes_in << ", \"bytes_out\": " << s.bytes_out << "}";
+        }
+        os << "\n],\n\"counters\": {";
+        bool first = true;
+        for (const auto& [name, value] : _counters) {
+            os << (first ? "\n" : ",\n") << "  \"" << name << "\": " << value;
+            first = false;
+        }
+        os << "\n},\n\"histograms\": {";
+        first = true;
+        for (const auto& [name, histogram] : _histograms) {
+            os << (first ? "\n" : ",\n") << "  \"" << name << "\": ";
+            histogram.write_json(os);
+            first = false;
+        }
+        os << "\n}";
+        if (_hardware) {
+            // null if perf_event_open was refused
+            os << ",\n\"hardware\": ";
+            if (_perf.running()) {
+                _perf.write_json(os);
+            } else {
+                os << "null";
+            }
+        }
+        os << "\n}" << std::endl;
+    }
+};
+
+enum class stats_mode { off, on, hardware };
+
+// recognises --stats and --stats=hw (with hardware counters), returns false for any other argument
+inline bool parse_stats_option(std::string_view arg, stats_mode& mode) {
+    if (arg == "--stats") {
+        mode = stats_mode::on;
+    } else if (arg == "--stats=hw") {
+        mode = stats_mode::hardware;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// null when off, so the result can be passed straight to the codecs
+inline std::unique_ptr<codec_stats> make_codec_stats(std::string codec, stats_mode mode) {
+    if (mode == stats_mode::off) {
+        return nullptr;
+    }
+    return std::make_unique<codec_stats>(std::move(codec), mode == stats_mode::hardware);
+}
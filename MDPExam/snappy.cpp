@@ -1,8 +1,14 @@
-#include <iostream>
+#include "snappy.hpp"
+
+#include <algorithm>
+#include <array>
 #include <cassert>
-#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <vector>
 
+namespace {
 
 template <typename T>
 std::istream& raw_read(std::istream& is, T& num, bool allow_empty = false, size_t size = sizeof(T)) {
@@ -43,11 +49,9 @@ size_t read_preamble(std::istream& is) {
     return result;
 }
 
-size_t symbols_printed = 0;
 void write_symbol(std::ostream& os, std::vector<uint8_t>& symbols, uint8_t value) {
     raw_write(os, value);
     symbols.push_back(value);
-    symbols_printed++;
 }
 
 void copy_from(std::ostream& os, const size_t offset, const size_t length, std::vector<uint8_t>& symbols) {
@@ -59,25 +63,41 @@ void copy_from(std::ostream& os, const size_t offset, const size_t length, std::
     }
 }
 
-int main(int argc, char* argv[]) {
-    assert(argc == 3);
-    std::string in_file = argv[1];
-    std::string out_file = argv[2];
+// tag and token counts of the decoder, only kept with STATS
+struct snappy_counts {
+    uint64_t bytes_in = 0;
+    uint64_t literal_tags = 0;
+    std::array<uint64_t, 4> copy_tags{}; // by tag type, 1, 2 and 4 byte offsets
+    log2_histogram literal_lengths, copy_lengths, copy_offsets;
 
-    std::ifstream is(in_file, std::ios::binary);
-    if (!is) {
-        std::cerr << "cannot open file " << in_file << std::endl;
-        return 1;
+    void report(codec_stats& stats, stats_clock::time_point start, uint64_t bytes_out) const {
+        stats.add_stage("decode", start, bytes_in, bytes_out);
+        stats.count("literal_tags", literal_tags);
+        stats.count("copy_1_byte_offset_tags", copy_tags[0b01]);
+        stats.count("copy_2_byte_offset_tags", copy_tags[0b10]);
+        stats.count("copy_4_byte_offset_tags", copy_tags[0b11]);
+        stats.add_histogram("literal_length", literal_lengths);
+        stats.add_histogram("copy_length", copy_lengths);
+        stats.add_histogram("copy_offset", copy_offsets);
     }
+};
 
-    std::ofstream os(out_file, std::ios::binary);
-    if (!os) {
-        std::cerr << "cannot open file " << out_file << std::endl;
-        return 1;
+template <bool STATS>
+bool decompress(std::istream& is, std::ostream& os, codec_stats* stats) {
+    [[maybe_unused]] stats_clock::time_point start;
+    [[maybe_unused]] snappy_counts counts;
+    if constexpr (STATS) {
+        start = stats_clock::now();
     }
 
-
     size_t uncompressed_file = read_preamble(is);
+    if constexpr (STATS) {
+        // the preamble is a varint, 7 bits per byte
+        counts.bytes_in = 1;
+        for (size_t rest = uncompressed_file >> 7; rest > 0; rest >>= 7) {
+            counts.bytes_in++;
+        }
+    }
 
     std::vector<uint8_t> symbols;
 
@@ -110,6 +130,11 @@ int main(int argc, char* argv[]) {
                 write_symbol(os, symbols, literal_value);
             }
             //std::cout << std::endl;
+            if constexpr (STATS) {
+                counts.bytes_in += 1 + ((tag >> 2) >= 60 ? (tag >> 2) - 59 : 0) + length;
+                counts.literal_tags++;
+                counts.literal_lengths.add(length);
+            }
 
         } else {
             // copy
@@ -139,12 +164,119 @@ int main(int argc, char* argv[]) {
                 raw_read(is, offset_32); // should be LE
                 offset = offset_32;
             }
+            if constexpr (STATS) {
+                counts.bytes_in += type == 0b11 ? 5 : type + 1;
+                counts.copy_tags[type]++;
+                counts.copy_lengths.add(length);
+                counts.copy_offsets.add(offset);
+            }
+            if (offset == 0 || offset > symbols.size()) {
+                // corrupt input, the copy would start before the first symbol
+                return false;
+            }
             copy_from(os, offset, length, symbols);
         }
     }
 
-    assert(symbols_printed == uncompressed_file);
+    if constexpr (STATS) {
+        counts.report(*stats, start, symbols.size());
+    }
+    return symbols.size() == uncompressed_file;
+}
+
+// copies reach at most this far back, so their offset fits in the two byte offset tags
+constexpr size_t MAX_OFFSET = (1 << 16) - 1;
+constexpr int HASH_BITS = 14;
+
+uint32_t load32(const uint8_t* p) {
+    uint32_t value;
+    std::memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t hash32(uint32_t bytes) {
+    return (bytes * 0x1e35a7bdu) >> (32 - HASH_BITS);
+}
+
+void write_preamble(std::ostream& os, size_t length) {
+    while (length >= 0b10000000) {
+        raw_write(os, static_cast<uint8_t>(length | 0b10000000));
+        length >>= 7;
+    }
+    raw_write(os, static_cast<uint8_t>(length));
+}
+
+void write_literal(std::ostream& os, const uint8_t* begin, size_t length) {
+    if (length == 0) {
+        return;
+    }
+    const size_t n = length - 1;
+    if (n < 60) {
+        raw_write(os, static_cast<uint8_t>(n << 2));
+    } else {
+        // tags 60 to 63: the length - 1 follows in 1 to 4 bytes, LE
+        uint8_t num_bytes = 1;
+        while (num_bytes < 4 && (n >> (8 * num_bytes)) != 0) {
+            num_bytes++;
+        }
+        raw_write(os, static_cast<uint8_t>((59 + num_bytes) << 2));
+        for (uint8_t byte = 0; byte < num_bytes; byte++) {
+            raw_write(os, static_cast<uint8_t>(n >> (8 * byte)));
+        }
+    }
+    os.write(reinterpret_cast<const char*>(begin), length);
+}
+
+void write_copy(std::ostream& os, size_t offset, size_t length) {
+    assert(offset > 0 && offset <= MAX_OFFSET);
+    while (length > 0) {
+        if (length >= 4 && length <= 11 && offset < 2048) {
+            // one byte offset: 3 more offset bits in the tag
+            raw_write(os, static_cast<uint8_t>(((offset >> 8) << 5) | ((length - 4) << 2) | 0b01));
+            raw_write(os, static_cast<uint8_t>(offset));
+            return;
+        }
+        const size_t chunk = std::min<size_t>(length, 64);
+        raw_write(os, static_cast<uint8_t>(((chunk - 1) << 2) | 0b10));
+        raw_write(os, static_cast<uint16_t>(offset)); // LE
+        length -= chunk;
+    }
+}
+}
+
+bool snappy_decompress(std::istream& is, std::ostream& os, codec_stats* stats) {
+    return stats ? decompress<true>(is, os, stats) : decompress<false>(is, os, nullptr);
+}
 
-    //std::cout << "Hello, World!" << std::endl;
-    return 0;
+bool snappy_compress(std::istream& is, std::ostream& os) {
+    const std::vector<uint8_t> bytes(std::istreambuf_iterator<char>(is), {});
+    const uint8_t* data = bytes.data();
+    const size_t size = bytes.size();
+    write_preamble(os, size);
+
+    // greedy matching: the last position of every hashed 4 byte sequence is a copy candidate
+    std::vector<uint32_t> table(size_t{1} << HASH_BITS, 0);
+    size_t literal_start = 0;
+    size_t pos = 0;
+    while (pos + 4 <= size) {
+        const uint32_t current = load32(data + pos);
+        const uint32_t h = hash32(current);
+        const size_t candidate = table[h];
+        table[h] = static_cast<uint32_t>(pos);
+        if (candidate >= pos || pos - candidate > MAX_OFFSET || load32(data + candidate) != current) {
+            pos++;
+            continue;
+        }
+
+        size_t length = 4;
+        while (pos + length < size && data[candidate + length] == data[pos + length]) {
+            length++;
+        }
+        write_literal(os, data + literal_start, pos - literal_start);
+        write_copy(os, pos - candidate, length);
+        pos += length;
+        literal_start = pos;
+    }
+    write_literal(os, data + literal_start, size - literal_start);
+    return static_cast<bool>(os);
 }
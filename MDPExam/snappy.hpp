@@ -0,0 +1,13 @@
+#pragma once
+
+#include "codec_stats.hpp"
+
+#include <istream>
+#include <ostream>
+
+// Decompresses a snappy stream (preamble + elements), false if the output size differs from the preamble.
+// With stats, the tags, literal and copy lengths and copy offsets are recorded.
+bool snappy_decompress(std::istream& is, std::ostream& os, codec_stats* stats = nullptr);
+// Compresses the whole stream into preamble + elements, greedily replacing repeated sequences by copies with
+// offsets below 64 KiB. False if writing fails.
+bool snappy_compress(std::istream& is, std::ostream& os);
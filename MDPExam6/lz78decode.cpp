@@ -0,0 +1,81 @@
+#include "lz78decode.hpp"
+
+#include <bit>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+namespace {
+
+// MSB first, the counterpart of the bitwriter of lz78encode
+class bitreader {
+    const std::vector<uint8_t>& _bytes;
+    size_t _position;
+
+public:
+    bitreader(const std::vector<uint8_t>& bytes) : _bytes{bytes}, _position{0} {
+
+    }
+
+    size_t bits_left() const {
+        return 8 * _bytes.size() - _position;
+    }
+
+    uint32_t operator()(uint8_t num_bits) {
+        uint32_t value = 0;
+        for (uint8_t bit = 0; bit < num_bits; bit++, _position++) {
+            value = (value << 1) | ((_bytes[_position / 8] >> (7 - _position % 8)) & 1);
+        }
+        return value;
+    }
+};
+
+// a dictionary entry is its longest proper prefix (0 = none) plus one character
+struct entry {
+    uint32_t prefix;
+    uint8_t character;
+};
+
+}
+
+bool lz78decode(std::istream& is, std::ostream& os) {
+    const std::vector<uint8_t> bytes(std::istreambuf_iterator<char>(is), {});
+    bitreader br(bytes);
+    if (br.bits_left() < 4 * 8 + 5 || br(8) != 'L' || br(8) != 'Z' || br(8) != '7' || br(8) != '8') {
+        return false;
+    }
+    const uint32_t maxbits = br(5);
+    const size_t MAX_DICTIONARY_LENGTH = (size_t{1} << maxbits) - 1;
+
+    std::vector<entry> dictionary; // entry i has index i + 1
+    std::vector<uint8_t> phrase;
+    while (true) {
+        // the encoder writes the index with as many bits as the current dictionary size needs
+        const uint8_t num_bits = std::bit_width(dictionary.size());
+        // less than a pair left: the padding of the last byte
+        if (br.bits_left() < num_bits + 8u) {
+            break;
+        }
+        const uint32_t index = br(num_bits);
+        const uint8_t character = br(8);
+        if (index > dictionary.size()) {
+            return false;
+        }
+
+        // the phrase is collected backwards along the prefixes
+        phrase.clear();
+        phrase.push_back(character);
+        for (uint32_t i = index; i != 0; i = dictionary[i - 1].prefix) {
+            phrase.push_back(dictionary[i - 1].character);
+        }
+        for (auto it = phrase.rbegin(); it != phrase.rend(); ++it) {
+            os.put(static_cast<char>(*it));
+        }
+
+        dictionary.push_back({index, character});
+        if (dictionary.size() > MAX_DICTIONARY_LENGTH) {
+            dictionary.clear();
+        }
+    }
+    return static_cast<bool>(os);
+}
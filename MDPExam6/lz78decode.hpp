@@ -0,0 +1,7 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+
+// Expands the output of lz78encode, false if the header is not "LZ78" or an index is out of range.
+bool lz78decode(std::istream& is, std::ostream& os);
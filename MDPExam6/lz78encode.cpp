@@ -6,7 +6,7 @@
 // Created by aloeser on 10.07.21.
 //
 
-//#include "lz78encode.hpp"
+#include "lz78encode.hpp"
 
 #include <string>
 #include <iostream>
@@ -16,6 +16,8 @@
 #include <cmath>
 #include <unordered_map>
 
+namespace {
+
 template <typename T>
 std::ostream& raw_write(std::ostream& os, T& value, size_t size = sizeof(T)) {
     return os.write(reinterpret_cast<const char*>(&value), size);
@@ -100,23 +102,35 @@ size_t find_longest_match(const std::unordered_map<std::string, uint32_t>& dicti
     return length_longest_match;
 }
 
-void write_index(bitwriter& bw, size_t index_longest_match, size_t dictionary_size) {
+// returns the number of bits written
+size_t write_index(bitwriter& bw, size_t index_longest_match, size_t dictionary_size) {
     size_t num_bits = std::ceil(std::log2(dictionary_size + 1));
     assert(index_longest_match < (1u << num_bits));
     bw(index_longest_match, num_bits);
+    return num_bits;
 }
 
-bool lz78encode(const std::string& input_filename, const std::string& output_filename, int maxbits) {
-    std::ifstream is(input_filename, std::ios::binary);
-    if (!is) {
-        std::cerr << "Could not open input file " << input_filename << std::endl;
-        return false;
+// phrase counts of the encoder, only kept with STATS
+struct lz78_counts {
+    uint64_t phrases = 0;
+    uint64_t dictionary_resets = 0;
+    uint64_t bits_out = 0;
+    log2_histogram match_lengths;
+
+    void report(codec_stats& stats, stats_clock::time_point start, uint64_t bytes_in) const {
+        stats.add_stage("encode", start, bytes_in, (bits_out + 7) / 8);
+        stats.count("phrases", phrases);
+        stats.count("dictionary_resets", dictionary_resets);
+        stats.add_histogram("match_length", match_lengths);
     }
+};
 
-    std::ofstream os(output_filename, std::ios::binary);
-    if (!os) {
-        std::cerr << "Could not open output file " << output_filename << std::endl;
-        return false;
+template <bool STATS>
+bool encode(std::istream& is, std::ostream& os, int maxbits, codec_stats* stats) {
+    [[maybe_unused]] stats_clock::time_point start;
+    [[maybe_unused]] lz78_counts counts;
+    if constexpr (STATS) {
+        start = stats_clock::now();
     }
 
     // read all the input
@@ -125,6 +139,10 @@ bool lz78encode(const std::string& input_filename, const std::string& output_fil
     while (raw_read(is, byte)) {
         bytes.push_back(byte);
     }
+    if constexpr (STATS) {
+        stats->add_stage("read", start, bytes.size(), bytes.size());
+        start = stats_clock::now();
+    }
     std::unordered_map<std::string, uint32_t> dictionary;
 
     // maxmimum number of entries in the dictionary before it has to be reset
@@ -150,7 +168,7 @@ bool lz78encode(const std::string& input_filename, const std::string& output_fil
         size_t length_longest_match = find_longest_match(dictionary, window, end_position != bytes.cend());
 
         size_t index = length_longest_match == 0 ? 0 : dictionary[window.substr(0, length_longest_match)];
-        write_index(bw, index, dictionary.size());
+        [[maybe_unused]] const size_t index_bits = write_index(bw, index, dictionary.size());
 
         uint8_t new_char = window[length_longest_match];
         bw(new_char, 8);
@@ -163,14 +181,47 @@ bool lz78encode(const std::string& input_filename, const std::string& output_fil
         dictionary[new_dictionary_key] = dictionary.size() + 1;
 
         max_dictionary_entry_length = std::max(max_dictionary_entry_length, length_longest_match + 1);
+        if constexpr (STATS) {
+            counts.phrases++;
+            counts.bits_out += index_bits + 8;
+            counts.match_lengths.add(length_longest_match);
+        }
         if (dictionary.size() > MAX_DICTIONARY_LENGTH) {
             dictionary.clear();
             max_dictionary_entry_length = 0;
+            if constexpr (STATS) {
+                counts.dictionary_resets++;
+            }
         }
 
         // advance the window
         position += length_longest_match + 1;
     }
 
+    if constexpr (STATS) {
+        counts.bits_out += 4 * 8 + 5; // header
+        counts.report(*stats, start, bytes.size());
+    }
     return true;
-}
\ No newline at end of file
+}
+}
+
+bool lz78encode(std::istream& is, std::ostream& os, int maxbits, codec_stats* stats) {
+    return stats ? encode<true>(is, os, maxbits, stats) : encode<false>(is, os, maxbits, nullptr);
+}
+
+bool lz78encode(const std::string& input_filename, const std::string& output_filename, int maxbits, codec_stats* stats) {
+    std::ifstream is(input_filename, std::ios::binary);
+    if (!is) {
+        std::cerr << "Could not open input file " << input_filename << std::endl;
+        return false;
+    }
+
+    std::ofstream os(output_filename, std::ios::binary);
+    if (!os) {
+        std::cerr << "Could not open output file " << output_filename << std::endl;
+        return false;
+    }
+
+    return lz78encode(is, os, maxbits, stats);
+}
@@ -1,5 +1,12 @@
 #pragma once
 
+#include "codec_stats.hpp"
+
+#include <istream>
+#include <ostream>
 #include <string>
 
-bool lz78encode(const std::string& input_filename, const std::string& output_filename, int maxbits);
\ No newline at end of file
+// with stats, the match lengths and dictionary resets are recorded
+bool lz78encode(const std::string& input_filename, const std::string& output_filename, int maxbits, codec_stats* stats = nullptr);
+// same as above, for any streams
+bool lz78encode(std::istream& is, std::ostream& os, int maxbits, codec_stats* stats = nullptr);
@@ -1,12 +1,39 @@
+#include "lz78decode.hpp"
 #include "lz78encode.hpp"
 #include <iostream>
 #include <cassert>
+#include <fstream>
+#include <string>
+#include <vector>
 
+// MDPExam6 [--stats|--stats=hw] <input> <output> <maxbits>
+// MDPExam6 -d <input> <output>
 int main(int argc, char* argv[]) {
-    assert(argc == 4);
-    const std::string input_filename = argv[1];
-    const std::string output_filename = argv[2];
-    const int maxbits = std::stoi(argv[3]);
-    lz78encode(input_filename, output_filename, maxbits);
+    if (argc == 4 && std::string(argv[1]) == "-d") {
+        std::ifstream is(argv[2], std::ios::binary);
+        std::ofstream os(argv[3], std::ios::binary);
+        if (!is || !os) {
+            std::cerr << "Could not open " << (is ? argv[3] : argv[2]) << std::endl;
+            return 1;
+        }
+        return lz78decode(is, os) ? 0 : 1;
+    }
+
+    stats_mode mode = stats_mode::off;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; i++) {
+        if (!parse_stats_option(argv[i], mode)) {
+            args.push_back(argv[i]);
+        }
+    }
+    assert(args.size() == 3);
+    const std::string input_filename = args[0];
+    const std::string output_filename = args[1];
+    const int maxbits = std::stoi(args[2]);
+    const auto stats = make_codec_stats("lz78_encode", mode);
+    lz78encode(input_filename, output_filename, maxbits, stats.get());
+    if (stats) {
+        stats->write_json(std::cerr);
+    }
     return 0;
 }
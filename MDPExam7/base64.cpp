@@ -0,0 +1,286 @@
+#include "base64.h"
+
+#include <array>
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+const char TABLE[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr uint8_t INVALID = 0xFF;
+
+constexpr std::array<uint8_t, 256> make_decode_table() {
+    std::array<uint8_t, 256> table{};
+    for (auto& value : table) {
+        value = INVALID;
+    }
+    for (int i = 0; i < 64; i++) {
+        table[static_cast<uint8_t>(TABLE[i])] = i;
+    }
+    return table;
+}
+
+constexpr std::array<uint8_t, 256> DECODE_TABLE = make_decode_table();
+
+void encode_groups_scalar(const uint8_t* in, size_t num_groups, char* out) {
+    for (size_t group = 0; group < num_groups; group++) {
+        const uint32_t bits = (in[0] << 16) | (in[1] << 8) | in[2];
+        out[0] = TABLE[bits >> 18];
+        out[1] = TABLE[(bits >> 12) & 0x3F];
+        out[2] = TABLE[(bits >> 6) & 0x3F];
+        out[3] = TABLE[bits & 0x3F];
+        in += 3;
+        out += 4;
+    }
+}
+
+// decodes complete groups of 4 characters without padding, returns false on invalid characters
+bool decode_groups_scalar(const char* in, size_t num_groups, uint8_t* out) {
+    for (size_t group = 0; group < num_groups; group++) {
+        const uint8_t a = DECODE_TABLE[static_cast<uint8_t>(in[0])];
+        const uint8_t b = DECODE_TABLE[static_cast<uint8_t>(in[1])];
+        const uint8_t c = DECODE_TABLE[static_cast<uint8_t>(in[2])];
+        const uint8_t d = DECODE_TABLE[static_cast<uint8_t>(in[3])];
+        if ((a | b | c | d) == INVALID) {
+            return false;
+        }
+        const uint32_t bits = (a << 18) | (b << 12) | (c << 6) | d;
+        out[0] = bits >> 16;
+        out[1] = bits >> 8;
+        out[2] = bits;
+        in += 4;
+        out += 3;
+    }
+    return true;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * Vectorized codec after W. Mula and D. Lemire, "Faster Base64 Encoding and Decoding Using AVX2 Instructions".
+ *
+ * Encoding: a shuffle places the 3 input bytes of every group into a 32 bit lane as [b1 b0 b2 b1], two
+ * multiplications move the four 6 bit fields into separate bytes, and a second shuffle turns every field into
+ * the offset that has to be added to reach its character.
+ */
+SSSE3 inline __m128i encode_split(__m128i in) {
+    in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+    const __m128i t0 = _mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00));
+    const __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    const __m128i t2 = _mm_and_si128(in, _mm_set1_epi32(0x003f03f0));
+    const __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+SSSE3 inline __m128i encode_lookup(__m128i indices) {
+    // 0..25 -> 13 ('A'), 26..51 -> 0 ('a' - 26), 52..61 -> 1..10 ('0' - 52), 62 -> 11 ('+'), 63 -> 12 ('/')
+    __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    const __m128i less = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+    reduced = _mm_or_si128(reduced, _mm_and_si128(less, _mm_set1_epi8(13)));
+    const __m128i shift = _mm_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                        '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    return _mm_add_epi8(_mm_shuffle_epi8(shift, reduced), indices);
+}
+
+// 12 bytes -> 16 characters per step, reads 16 bytes
+SSSE3 size_t encode_ssse3(const uint8_t* in, size_t num_groups, char* out) {
+    size_t group = 0;
+    for (; group + 6 <= num_groups; group += 4) {
+        const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 3 * group));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 4 * group), encode_lookup(encode_split(bytes)));
+    }
+    return group;
+}
+
+// 24 bytes -> 32 characters per step: every 128 bit lane handles 12 bytes like the SSSE3 version
+AVX2 size_t encode_avx2(const uint8_t* in, size_t num_groups, char* out) {
+    const __m256i split_shuffle = _mm256_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+                                                   1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10);
+    const __m256i shift = _mm256_setr_epi8('a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0,
+                                           'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+                                           '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+    size_t group = 0;
+    // the high lane reads 4 bytes past its 12, so stop while at least 2 more groups follow
+    for (; group + 10 <= num_groups; group += 8) {
+        const uint8_t* bytes = in + 3 * group;
+        __m256i v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 12)), 1);
+        v = _mm256_shuffle_epi8(v, split_shuffle);
+        const __m256i t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+        const __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        const __m256i t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+        const __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        const __m256i indices = _mm256_or_si256(t1, t3);
+
+        __m256i reduced = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        const __m256i less = _mm256_cmpgt_epi8(_mm256_set1_epi8(26), indices);
+        reduced = _mm256_or_si256(reduced, _mm256_and_si256(less, _mm256_set1_epi8(13)));
+        const __m256i chars = _mm256_add_epi8(_mm256_shuffle_epi8(shift, reduced), indices);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4 * group), chars);
+    }
+    return group + encode_ssse3(in + 3 * group, num_groups - group, out + 4 * group);
+}
+
+/*
+ * Decoding: the high and low nibble of every character index two small tables whose AND is non-zero exactly for
+ * characters outside the alphabet; a third table, indexed by the high nibble, gives the offset back to the 6 bit
+ * value. Two multiply-adds then pack 4 values of 6 bits into 3 bytes per 32 bit lane.
+ */
+SSSE3 inline bool decode_values(__m128i& chars) {
+    const __m128i lut_lo = _mm_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                         0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m128i lut_hi = _mm_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                         0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m128i lut_roll = _mm_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m128i mask_2f = _mm_set1_epi8(0x2f);
+
+    const __m128i hi_nibbles = _mm_and_si128(_mm_srli_epi32(chars, 4), mask_2f);
+    const __m128i lo_nibbles = _mm_and_si128(chars, mask_2f);
+    const __m128i hi = _mm_shuffle_epi8(lut_hi, hi_nibbles);
+    const __m128i lo = _mm_shuffle_epi8(lut_lo, lo_nibbles);
+    // _mm_testz_si128 would need SSE4.1
+    if (_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(lo, hi), _mm_setzero_si128())) != 0xFFFF) {
+        return false;
+    }
+    const __m128i eq_2f = _mm_cmpeq_epi8(chars, mask_2f); // '/' shares its high nibble with '+'
+    const __m128i roll = _mm_shuffle_epi8(lut_roll, _mm_add_epi8(eq_2f, hi_nibbles));
+    chars = _mm_add_epi8(chars, roll);
+    return true;
+}
+
+SSSE3 inline __m128i decode_pack(__m128i values) {
+    const __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+    const __m128i packed = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+    return _mm_shuffle_epi8(packed, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+// 16 characters -> 12 bytes per step, writes 16 bytes. Returns the number of groups decoded, stops at invalid characters
+SSSE3 size_t decode_ssse3(const char* in, size_t num_groups, uint8_t* out) {
+    size_t group = 0;
+    // the 4 bytes written past the 12 have to be overwritten by at least 2 more groups
+    for (; group + 6 <= num_groups; group += 4) {
+        __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 4 * group));
+        if (!decode_values(chars)) {
+            break;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 3 * group), decode_pack(chars));
+    }
+    return group;
+}
+
+// 32 characters -> 24 bytes per step, writes 32 bytes
+AVX2 size_t decode_avx2(const char* in, size_t num_groups, uint8_t* out) {
+    const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                            0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                            0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+    const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                            0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                            0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+    const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                              0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+    const __m256i pack_shuffle = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                                  2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+    size_t group = 0;
+    for (; group + 12 <= num_groups; group += 8) {
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 4 * group));
+        const __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(chars, 4), mask_2f);
+        const __m256i lo_nibbles = _mm256_and_si256(chars, mask_2f);
+        const __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+        const __m256i lo = _mm256_shuffle_epi8(lut_lo, lo_nibbles);
+        if (!_mm256_testz_si256(lo, hi)) {
+            break;
+        }
+        const __m256i eq_2f = _mm256_cmpeq_epi8(chars, mask_2f);
+        chars = _mm256_add_epi8(chars, _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles)));
+
+        const __m256i merged = _mm256_maddubs_epi16(chars, _mm256_set1_epi32(0x01400140));
+        __m256i packed = _mm256_madd_epi16(merged, _mm256_set1_epi32(0x00011000));
+        packed = _mm256_shuffle_epi8(packed, pack_shuffle);
+        // 12 bytes per lane -> 24 contiguous bytes
+        packed = _mm256_permutevar8x32_epi32(packed, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 3 * group), packed);
+    }
+    return group + decode_ssse3(in + 4 * group, num_groups - group, out + 3 * group);
+}
+
+#endif
+
+}
+
+void base64_encode_groups(const uint8_t* in, size_t num_bytes, char* out) {
+    const size_t num_groups = num_bytes / 3;
+    size_t group = 0;
+#ifdef HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        group = encode_avx2(in, num_groups, out);
+    } else if (__builtin_cpu_supports("ssse3")) {
+        group = encode_ssse3(in, num_groups, out);
+    }
+#endif
+    encode_groups_scalar(in + 3 * group, num_groups - group, out + 4 * group);
+}
+
+void base64_encode(const uint8_t* in, size_t num_bytes, char* out) {
+    const size_t full = num_bytes / 3 * 3;
+    base64_encode_groups(in, full, out);
+
+    const size_t rest = num_bytes - full;
+    if (rest > 0) {
+        char* last = out + full / 3 * 4;
+        const uint8_t byte1 = in[full];
+        const uint8_t byte2 = rest == 2 ? in[full + 1] : 0;
+        last[0] = TABLE[byte1 >> 2];
+        last[1] = TABLE[((byte1 & 0x03) << 4) | (byte2 >> 4)];
+        last[2] = rest == 2 ? TABLE[(byte2 & 0x0F) << 2] : '=';
+        last[3] = '=';
+    }
+}
+
+bool base64_decode(const char* in, size_t num_chars, uint8_t* out, size_t& num_bytes) {
+    num_bytes = 0;
+    if (num_chars % 4 != 0) {
+        return false;
+    }
+    if (num_chars == 0) {
+        return true;
+    }
+    // the last group may be padded, it is decoded separately
+    const size_t num_groups = num_chars / 4 - 1;
+    size_t group = 0;
+#ifdef HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        group = decode_avx2(in, num_groups, out);
+    } else if (__builtin_cpu_supports("ssse3")) {
+        group = decode_ssse3(in, num_groups, out);
+    }
+#endif
+    // the vector loops stop early on invalid characters, the scalar code then finds them
+    if (!decode_groups_scalar(in + 4 * group, num_groups - group, out + 3 * group)) {
+        return false;
+    }
+
+    const char* last = in + 4 * num_groups;
+    const size_t padding = last[3] != '=' ? 0 : (last[2] != '=' ? 1 : 2);
+    char group_chars[4] = {last[0], last[1], last[2], last[3]};
+    for (size_t i = 4 - padding; i < 4; i++) {
+        group_chars[i] = 'A';
+    }
+    uint8_t group_bytes[3];
+    if (!decode_groups_scalar(group_chars, 1, group_bytes)) {
+        return false;
+    }
+    std::memcpy(out + 3 * num_groups, group_bytes, 3 - padding);
+    num_bytes = 3 * num_groups + 3 - padding;
+    return true;
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// 4 characters per started group of 3 bytes, the last group is padded with '='
+constexpr size_t base64_encoded_size(size_t num_bytes) { return (num_bytes + 2) / 3 * 4; }
+
+// upper bound, the exact size depends on the padding
+constexpr size_t base64_decoded_max_size(size_t num_chars) { return num_chars / 4 * 3; }
+
+// Encodes num_bytes bytes into exactly base64_encoded_size(num_bytes) characters at out.
+void base64_encode(const uint8_t* in, size_t num_bytes, char* out);
+
+// Encodes a multiple of 3 bytes without padding, for encoding a stream in pieces.
+void base64_encode_groups(const uint8_t* in, size_t num_bytes, char* out);
+
+/*
+ * Decodes num_chars characters (a multiple of 4, optionally ending with one or two '=') into out,
+ * which must have room for base64_decoded_max_size(num_chars) bytes.
+ * Returns false on characters outside the base64 alphabet or a malformed length.
+ */
+bool base64_decode(const char* in, size_t num_chars, uint8_t* out, size_t& num_bytes);
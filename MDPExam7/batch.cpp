@@ -0,0 +1,355 @@
+#include "batch.h"
+#include "compress.h"
+#include "container.h"
+#include "filter.h"
+#include "mapped_file.h"
+#include "mat.h"
+#include "process_ppm.h"
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <system_error>
+
+namespace {
+
+constexpr size_t STRIP_PIXELS = 1 << 20;  // images up to this size are a single task
+constexpr size_t JOBS_PER_THREAD = 4;     // images in flight, bounds the memory of results waiting to be written
+
+// PackBits packets of one plane, parsed as if the encoding started at the first row of the strip
+struct strip_packets
+{
+    std::vector<uint8_t> packets;
+    std::vector<size_t> starts;   // plane offset of every packet
+    std::vector<size_t> offsets;  // where that packet begins in packets
+    size_t end = 0;               // plane offset after the last packet, can be a little past the strip
+};
+
+void encode_strip(const uint8_t* plane, size_t begin, size_t stop, size_t plane_size, strip_packets& strip) {
+    const uint8_t* it = plane + begin;
+    while (it < plane + stop) {
+        strip.starts.push_back(it - plane);
+        strip.offsets.push_back(strip.packets.size());
+        it = packbits_encode_packets(it, it + 1, plane + plane_size, strip.packets);
+    }
+    strip.end = it - plane;
+}
+
+/*
+ * Joins the strips to exactly the codes of PackBitsEncode on the whole plane. The packets only depend on where
+ * they start, so once the real parse reaches a packet start of a strip, the rest of that strip is taken as it is.
+ * Until then (usually a few packets after a strip border) the packets are encoded again.
+ */
+void join_strips(const uint8_t* plane, size_t plane_size, const std::vector<strip_packets>& strips, std::vector<uint8_t>& encoded) {
+    size_t pos = 0;
+    for (const auto& strip : strips) {
+        auto start = std::lower_bound(strip.starts.begin(), strip.starts.end(), pos);
+        while (pos < strip.end && (start == strip.starts.end() || *start != pos)) {
+            pos = packbits_encode_packets(plane + pos, plane + pos + 1, plane + plane_size, encoded) - plane;
+            start = std::lower_bound(start, strip.starts.end(), pos);
+        }
+        if (pos < strip.end) {
+            const size_t offset = strip.offsets[start - strip.starts.begin()];
+            encoded.insert(encoded.end(), strip.packets.begin() + offset, strip.packets.end());
+            pos = strip.end;
+        }
+    }
+    // the packets of the last strip run to the end of the plane
+    assert(pos == plane_size);
+    encoded.push_back(128); // EOD
+}
+
+using plane_views = std::array<mat_view<uint8_t>, 6>;
+
+// splits rows of the image into its byte planes, out holds views of rows x width
+void split_rows(const uint8_t* data, const ppm_header& header, int row, int rows, const plane_views& out) {
+    const int cols = header.width;
+    if (NumBytePlanes(header) == 3) {
+        SplitRGB(PPMPixels(data, header).sub(row, 0, rows, cols), out[0], out[1], out[2]);
+        return;
+    }
+    std::array<mat<uint16_t>, 3> samples;
+    for (auto& s : samples) {
+        s.resize(rows, cols);
+    }
+    SplitRGB16BE(PPMPayload(data, header).sub(row, 0, rows, 6 * cols), samples[0].view(), samples[1].view(), samples[2].view());
+    for (size_t channel = 0; channel < 3; channel++) {
+        SplitBytes(samples[channel].view(), out[channel], out[3 + channel]);
+    }
+}
+
+// where the output of input goes with an output directory
+std::filesystem::path output_path(const std::string& input, const batch_options& options) {
+    const auto extension = options.container ? ".mdp7" : ".json";
+    return std::filesystem::path(options.output_dir) / std::filesystem::path(input).stem().concat(extension);
+}
+
+struct image_job
+{
+    size_t index;
+    std::string filename;
+    mapped_file file;
+    ppm_header header;
+    int rows_per_strip = 0, num_strips = 0;
+    size_t num_planes = 0;                 // see NumBytePlanes
+    std::array<mat<uint8_t>, 6> planes;
+    std::array<mat<uint8_t>, 6> filtered;  // with the filter byte in front of every row, if filtering
+    std::array<std::vector<strip_packets>, 6> strips;
+    std::atomic<int> remaining{0};
+};
+
+class batch_run
+{
+    const std::vector<std::string>& inputs_;
+    const batch_options& options_;
+
+    // results by input index, written (or just counted) in input order by the main thread
+    std::mutex mutex_;
+    std::condition_variable finished_;
+    std::vector<std::string> results_;
+    std::vector<char> done_, ok_;
+    std::atomic<size_t> num_bytes_{0};
+
+    // last, so the workers are gone before anything they use
+    thread_pool pool_;
+
+    void finish(image_job& job, std::string result, bool ok) {
+        {
+            std::lock_guard lock(mutex_);
+            results_[job.index] = std::move(result);
+            done_[job.index] = true;
+            ok_[job.index] = ok;
+        }
+        finished_.notify_all();
+    }
+
+    void load(std::shared_ptr<image_job> job) {
+        if (!job->file.open(job->filename)) {
+            std::cerr << "Cannot open image file " << job->filename << std::endl;
+            return finish(*job, {}, false);
+        }
+        if (!ParsePPMHeader(job->file.data(), job->file.size(), job->header, job->filename)) {
+            return finish(*job, {}, false);
+        }
+
+        const auto& header = job->header;
+        job->rows_per_strip = std::max<size_t>(1, STRIP_PIXELS / header.width);
+        job->num_strips = (header.height + job->rows_per_strip - 1) / job->rows_per_strip;
+        job->num_planes = NumBytePlanes(header);
+        for (size_t plane = 0; plane < job->num_planes; plane++) {
+            job->planes[plane].resize(header.height, header.width);
+            if (options_.filter) {
+                job->filtered[plane].resize(header.height, header.width + 1);
+            }
+            job->strips[plane].resize(job->num_strips);
+        }
+        if (job->num_strips == 1) {
+            split(*job, 0);
+            encode(*job, 0);
+            return serialize(*job);
+        }
+
+        // all strips are split before any is encoded, as the packets at the end of a strip look into the next one
+        job->remaining = job->num_strips;
+        for (int strip = 0; strip < job->num_strips; strip++) {
+            pool_.submit([this, job, strip] {
+                split(*job, strip);
+                if (--job->remaining == 0) {
+                    encode_all(job);
+                }
+            });
+        }
+    }
+
+    void encode_all(std::shared_ptr<image_job> job) {
+        job->remaining = job->num_strips;
+        for (int strip = 0; strip < job->num_strips; strip++) {
+            pool_.submit([this, job, strip] {
+                encode(*job, strip);
+                if (--job->remaining == 0) {
+                    serialize(*job);
+                }
+            });
+        }
+    }
+
+    void split(image_job& job, int strip) {
+        const int row = strip * job.rows_per_strip;
+        const int rows = std::min<int>(job.rows_per_strip, job.header.height - row);
+        const int cols = job.header.width;
+        plane_views planes;
+        for (size_t plane = 0; plane < job.num_planes; plane++) {
+            planes[plane] = job.planes[plane].sub(row, 0, rows, cols);
+        }
+        split_rows(job.file.data(), job.header, row, rows, planes);
+        if (!options_.filter) {
+            return;
+        }
+
+        // the row above belongs to another strip, which may not be split yet, so it is split again here
+        mat<uint8_t> above[6];
+        if (row > 0) {
+            plane_views above_views;
+            for (size_t plane = 0; plane < job.num_planes; plane++) {
+                above[plane].resize(1, cols);
+                above_views[plane] = above[plane].view();
+            }
+            split_rows(job.file.data(), job.header, row - 1, 1, above_views);
+        }
+        for (size_t plane = 0; plane < job.num_planes; plane++) {
+            FilterRows(job.planes[plane].sub(row, 0, rows, cols), row > 0 ? above[plane].data() : nullptr,
+                       job.filtered[plane].sub(row, 0, rows, cols + 1));
+        }
+    }
+
+    // the bytes given to PackBits
+    const mat<uint8_t>& coded(const image_job& job, size_t plane) const {
+        return options_.filter ? job.filtered[plane] : job.planes[plane];
+    }
+
+    void encode(image_job& job, int strip) {
+        const size_t strip_size = size_t(coded(job, 0).cols()) * job.rows_per_strip;
+        const size_t plane_size = coded(job, 0).size();
+        const size_t begin = strip * strip_size;
+        const size_t stop = std::min(begin + strip_size, plane_size);
+        for (size_t plane = 0; plane < job.num_planes; plane++) {
+            encode_strip(coded(job, plane).data(), begin, stop, plane_size, job.strips[plane][strip]);
+        }
+    }
+
+    void serialize(image_job& job) {
+        std::vector<std::vector<uint8_t>> encoded(job.num_planes);
+        for (size_t plane = 0; plane < job.num_planes; plane++) {
+            join_strips(coded(job, plane).data(), coded(job, plane).size(), job.strips[plane], encoded[plane]);
+            job.strips[plane].clear();
+            job.planes[plane] = mat<uint8_t>();
+            job.filtered[plane] = mat<uint8_t>();
+        }
+
+        image_codes codes;
+        codes.width = job.header.width;
+        codes.rows = job.header.height;
+        codes.max_color_value = job.header.max_color_value;
+        codes.filtered = options_.filter;
+        codes.planes.assign(encoded.begin(), encoded.end());
+        std::string output;
+        if (options_.container) {
+            WriteContainer(codes, output);
+        } else {
+            WriteJSON(codes, output);
+            output += "\n";
+        }
+        num_bytes_ += job.file.size();
+        job.file.close();
+
+        if (options_.output_dir.empty()) {
+            return finish(job, std::move(output), true);
+        }
+        const auto path = output_path(job.filename, options_);
+        std::ofstream os(path, std::ios::binary);
+        os.write(output.data(), output.size());
+        if (!os) {
+            std::cerr << "Cannot write " << path.string() << std::endl;
+            return finish(job, {}, false);
+        }
+        finish(job, {}, true);
+    }
+
+public:
+    batch_run(const std::vector<std::string>& inputs, const batch_options& options)
+        : inputs_(inputs), options_(options), results_(inputs.size()), done_(inputs.size()), ok_(inputs.size()),
+          pool_(options.num_threads) {}
+
+    bool run() {
+        const auto start = std::chrono::steady_clock::now();
+        const size_t window = JOBS_PER_THREAD * pool_.size();
+        size_t submitted = 0, num_failed = 0;
+        for (size_t next = 0; next < inputs_.size(); next++) {
+            for (; submitted < inputs_.size() && submitted < next + window; submitted++) {
+                auto job = std::make_shared<image_job>();
+                job->index = submitted;
+                job->filename = inputs_[submitted];
+                pool_.submit([this, job] { load(job); });
+            }
+
+            std::string result;
+            {
+                std::unique_lock lock(mutex_);
+                finished_.wait(lock, [this, next] { return done_[next] != 0; });
+                result = std::move(results_[next]);
+                num_failed += !ok_[next];
+            }
+            std::cout.write(result.data(), result.size());
+        }
+        pool_.wait();
+        std::cout.flush();
+
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const double megabytes = num_bytes_ / 1e6;
+        const size_t num_images = inputs_.size() - num_failed;
+        std::cerr << "batch: " << num_images << " images (" << num_failed << " failed), " << megabytes << " MB in "
+                  << seconds << " s: " << num_images / seconds << " images/s, " << megabytes / seconds << " MB/s"
+                  << " on " << pool_.size() << " threads" << std::endl;
+        return num_failed == 0;
+    }
+};
+
+}
+
+std::vector<std::string> CollectInputs(const std::vector<std::string>& paths) {
+    std::vector<std::string> inputs;
+    for (const auto& path : paths) {
+        std::error_code error;
+        if (!std::filesystem::is_directory(path, error)) {
+            inputs.push_back(path);
+            continue;
+        }
+        std::vector<std::string> files;
+        for (const auto& entry : std::filesystem::directory_iterator(path, error)) {
+            if (entry.is_regular_file(error) && entry.path().extension() == ".ppm") {
+                files.push_back(entry.path().string());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        inputs.insert(inputs.end(), files.begin(), files.end());
+    }
+    return inputs;
+}
+
+bool RunBatch(const std::vector<std::string>& inputs, const batch_options& options) {
+    if (!options.output_dir.empty()) {
+        // the outputs are named after the inputs without their directory, so the names could collide
+        std::map<std::filesystem::path, const std::string*> outputs;
+        bool unique = true;
+        for (const auto& input : inputs) {
+            const auto [it, inserted] = outputs.emplace(output_path(input, options), &input);
+            if (!inserted) {
+                std::cerr << "Both " << *it->second << " and " << input << " would be written to " << it->first.string() << std::endl;
+                unique = false;
+            }
+        }
+        if (!unique) {
+            return false;
+        }
+        // before any image is encoded, a missing directory would only fail at the first write
+        std::error_code error;
+        std::filesystem::create_directories(options.output_dir, error);
+        if (error) {
+            std::cerr << "Cannot create " << options.output_dir << ": " << error.message() << std::endl;
+            return false;
+        }
+    }
+    batch_run run(inputs, options);
+    return run.run();
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+struct batch_options
+{
+    size_t num_threads = 0;  // 0: one per hardware thread
+    std::string output_dir;  // empty: all JSONs go to stdout in input order, otherwise one <name>.json per image
+    bool filter = false;     // PNG filters before PackBits, see FilterRows
+    bool container = false;  // binary containers (<name>.mdp7) instead of JSON, see container.h
+};
+
+// Expands directories in paths to the .ppm files they contain (sorted by name), other paths are kept as they are.
+std::vector<std::string> CollectInputs(const std::vector<std::string>& paths);
+
+/*
+ * Encodes every image to the same JSON or container as StreamJSON/StreamContainer, on a work stealing thread pool. Large images are split
+ * into strips of rows, so they are spread over the workers as well. Prints images/s and MB/s to stderr.
+ * Returns false if any image failed, or before encoding anything if two inputs would go to the same file in the
+ * output directory.
+ */
+bool RunBatch(const std::vector<std::string>& inputs, const batch_options& options);
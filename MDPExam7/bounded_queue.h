@@ -0,0 +1,46 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+
+// Blocking FIFO with a fixed capacity, so a fast producer cannot run ahead of its consumer by more than
+// capacity items. After close, pop drains the remaining items and then returns false.
+template <typename T>
+class bounded_queue
+{
+    std::deque<T> items_;
+    size_t capacity_;
+    bool closed_ = false;
+    std::mutex mutex_;
+    std::condition_variable not_empty_, not_full_;
+
+public:
+    explicit bounded_queue(size_t capacity) : capacity_(capacity) {}
+
+    void push(T item) {
+        std::unique_lock lock(mutex_);
+        not_full_.wait(lock, [this] { return items_.size() < capacity_; });
+        items_.push_back(std::move(item));
+        not_empty_.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock lock(mutex_);
+        not_empty_.wait(lock, [this] { return !items_.empty() || closed_; });
+        if (items_.empty()) {
+            return false;
+        }
+        item = std::move(items_.front());
+        items_.pop_front();
+        not_full_.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard lock(mutex_);
+        closed_ = true;
+        not_empty_.notify_all();
+    }
+};
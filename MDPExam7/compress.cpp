@@ -2,13 +2,16 @@
 // Created by aloeser on 11.07.21.
 //
 
-//#include "compress.h"
+#include "compress.h"
+#include "base64.h"
 #include "mat.h"
 #include <cassert>
+#include <cstring>
+#include <string>
 #include <vector>
 
 size_t detect_run_length(const uint8_t *pos, const uint8_t *end) {
-    char current = *pos;
+    const uint8_t current = *pos;
     size_t length = 0;
     pos++;
     bool run = false;
@@ -45,14 +48,10 @@ size_t detect_copy_length(const uint8_t *it, const uint8_t *end) {
     return copy_length;
 }
 
-void PackBitsEncode(const mat<uint8_t>& img, std::vector<uint8_t>& encoded) {
-    auto it = img.data();
-    const auto end = img.data() + (img.rows()*img.cols());
-
-    size_t pixels_processed = 0;
-
-    while (it != end) {
-        assert(it < end);
+template <bool STATS>
+const uint8_t* encode_packets(const uint8_t* it, const uint8_t* stop, const uint8_t* end, std::vector<uint8_t>& encoded,
+                              packbits_counts* counts) {
+    while (it < stop) {
         const size_t current_run = detect_run_length(it, end);
         assert(it + current_run <= end);
         if (current_run > 0) {
@@ -60,59 +59,91 @@ void PackBitsEncode(const mat<uint8_t>& img, std::vector<uint8_t>& encoded) {
             encoded.push_back(L);
             encoded.push_back(*it);
             it += current_run;
-            pixels_processed += current_run;
+            if constexpr (STATS) {
+                counts->run_packets++;
+                counts->run_lengths.add(current_run);
+            }
         } else {
             const size_t copy_length = detect_copy_length(it, end);
             assert(it + copy_length <= end);
             const uint8_t L = copy_length - 1;
             encoded.push_back(L);
-            for (size_t i = 0; i < copy_length; i++) {
-                encoded.push_back(*it);
-                it++;
-                pixels_processed++;
+            encoded.insert(encoded.end(), it, it + copy_length);
+            it += copy_length;
+            if constexpr (STATS) {
+                counts->literal_packets++;
+                counts->literal_lengths.add(copy_length);
             }
         }
     }
-    assert(pixels_processed == img.size());
-
-    encoded.push_back(128); // EOD
+    return it;
 }
 
+const uint8_t* packbits_encode_packets(const uint8_t* it, const uint8_t* stop, const uint8_t* end, std::vector<uint8_t>& encoded,
+                                       packbits_counts* counts) {
+    return counts ? encode_packets<true>(it, stop, end, encoded, counts) : encode_packets<false>(it, stop, end, encoded, nullptr);
+}
 
-std::vector<uint8_t> get_base64(uint8_t byte1, uint8_t byte2, uint8_t byte3) {
-    uint8_t base64_1 = (byte1 & 0xFC) >> 2 ; // first six bits of byte 1
-    uint8_t base64_2 = ((byte1 & 0x03) << 4) + ((byte2 & 0xF0) >> 4); // last two bits of byte1 + first four bits of byte2
-    uint8_t base64_3 = ((byte2 & 0x0F) << 2)  + ((byte3 & 0xC0) >> 6); // last four bits of byte 2  + first two of byte3
-    uint8_t base64_4 = byte3 & 0x3F; // prune the first two bits of the last byte
-    assert(base64_1  < 64);
-    assert(base64_2  < 64);
-    assert(base64_3  < 64);
-    assert(base64_4  < 64);
-    return {base64_1, base64_2, base64_3, base64_4};
+void packbits_counts::report(codec_stats& stats) const {
+    stats.count("run_packets", run_packets);
+    stats.count("literal_packets", literal_packets);
+    stats.add_histogram("run_length", run_lengths);
+    stats.add_histogram("literal_length", literal_lengths);
 }
 
-std::string Base64Encode(const std::vector<uint8_t>& v) {
-    const std::string TABLE = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
-    std::string result;
+void PackBitsEncode(const mat<uint8_t>& img, std::vector<uint8_t>& encoded) {
+    assert(img.is_contiguous());
+    const auto begin = img.data();
+    const auto end = img.data() + (img.rows()*img.cols());
 
-    for (size_t i = 0; i < v.size(); i += 3) {
-        uint8_t byte1 = v[i], byte2, byte3;
-        if (i + 1 >= v.size()) {
-            byte2 =  128;
-        } else {
-            byte2 = v[i+1];
-        }
-        if (i + 2 >= v.size()) {
-            byte3 = 128;
-        } else {
-            byte3 = v[i+2];
-        }
+    const auto it = packbits_encode_packets(begin, end, end, encoded);
+    assert(it == end);
+
+    encoded.push_back(128); // EOD
+}
 
-        const auto base64_values = get_base64(byte1, byte2, byte3);
-        for (const auto base64_value : base64_values) {
-            result += TABLE[base64_value];
+bool PackBitsDecode(const uint8_t* codes, size_t num_codes, uint8_t* out, size_t out_size) {
+    const uint8_t* end = codes + num_codes;
+    uint8_t* pos = out;
+    uint8_t* out_end = out + out_size;
+    while (codes < end) {
+        const uint8_t L = *codes++;
+        if (L < 128) {
+            // copy of L + 1 bytes
+            const size_t length = L + 1;
+            if (static_cast<size_t>(end - codes) < length || static_cast<size_t>(out_end - pos) < length) {
+                return false;
+            }
+            std::memcpy(pos, codes, length);
+            codes += length;
+            pos += length;
+        } else if (L > 128) {
+            // run of 257 - L times the next byte
+            const size_t length = 257 - L;
+            if (codes == end || static_cast<size_t>(out_end - pos) < length) {
+                return false;
+            }
+            std::memset(pos, *codes++, length);
+            pos += length;
+        } else {
+            break; // EOD
         }
     }
+    return pos == out_end;
+}
+
 
+std::string Base64Encode(const std::vector<uint8_t>& v) {
+    // the output size is known upfront, so the characters are written straight into the string
+    std::string result(base64_encoded_size(v.size()), '\0');
+    base64_encode(v.data(), v.size(), result.data());
     return result;
-}
\ No newline at end of file
+}
+
+bool Base64Decode(const std::string& s, std::vector<uint8_t>& decoded) {
+    decoded.resize(base64_decoded_max_size(s.size()));
+    size_t num_bytes;
+    const bool valid = base64_decode(s.data(), s.size(), decoded.data(), num_bytes);
+    decoded.resize(num_bytes);
+    return valid;
+}
@@ -4,8 +4,30 @@
 
 #pragma once
 
+#include "codec_stats.hpp"
 #include "mat.h"
+#include <string>
 #include <vector>
 
 void PackBitsEncode(const mat<uint8_t>& img, std::vector<uint8_t>& encoded);
-std::string Base64Encode(const std::vector<uint8_t>& v);
\ No newline at end of file
+
+// Packets written by the PackBits encoder, kept per thread and reported once at the end (--stats).
+struct packbits_counts {
+    uint64_t run_packets = 0, literal_packets = 0;
+    log2_histogram run_lengths, literal_lengths;
+
+    void report(codec_stats& stats) const;
+};
+
+// Appends the PackBits packets starting before stop (without EOD) and returns where the next packet starts.
+// The packets are chosen looking at most PACKBITS_LOOKAHEAD bytes ahead, but never beyond end.
+// With counts, the packets are counted as well.
+const uint8_t* packbits_encode_packets(const uint8_t* it, const uint8_t* stop, const uint8_t* end, std::vector<uint8_t>& encoded,
+                                       packbits_counts* counts = nullptr);
+constexpr size_t PACKBITS_LOOKAHEAD = 129;
+
+// Expands PackBits codes (up to EOD or their end) into exactly out_size bytes, false if they do not fit.
+bool PackBitsDecode(const uint8_t* codes, size_t num_codes, uint8_t* out, size_t out_size);
+
+std::string Base64Encode(const std::vector<uint8_t>& v);
+bool Base64Decode(const std::string& s, std::vector<uint8_t>& decoded);
\ No newline at end of file
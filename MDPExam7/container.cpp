@@ -0,0 +1,95 @@
+#include "container.h"
+#include "base64.h"
+
+#include <cstring>
+
+namespace {
+
+size_t align_up(size_t offset) {
+    return (offset + CONTAINER_ALIGNMENT - 1) / CONTAINER_ALIGNMENT * CONTAINER_ALIGNMENT;
+}
+
+}
+
+void WriteContainer(const image_codes& codes, std::string& out) {
+    const size_t begin = out.size();
+    container_header header{};
+    std::memcpy(header.magic, CONTAINER_MAGIC, sizeof(header.magic));
+    header.version = CONTAINER_VERSION;
+    header.flags = codes.filtered ? CONTAINER_FILTERED : 0;
+    header.width = codes.width;
+    header.rows = codes.rows;
+    header.num_planes = codes.planes.size();
+    header.max_color_value = codes.max_color_value == 255 ? 0 : codes.max_color_value;
+
+    std::vector<container_plane> table(codes.planes.size());
+    size_t offset = sizeof(header) + table.size() * sizeof(container_plane);
+    for (size_t i = 0; i < table.size(); i++) {
+        offset = align_up(offset);
+        table[i] = {offset, codes.planes[i].size()};
+        offset += codes.planes[i].size();
+    }
+
+    // the padding stays zero
+    out.resize(begin + offset, '\0');
+    char* base = out.data() + begin;
+    std::memcpy(base, &header, sizeof(header));
+    std::memcpy(base + sizeof(header), table.data(), table.size() * sizeof(container_plane));
+    for (size_t i = 0; i < table.size(); i++) {
+        std::memcpy(base + table[i].offset, codes.planes[i].data(), table[i].size);
+    }
+}
+
+void WriteJSON(const image_codes& codes, std::string& out) {
+    out += "{\n";
+    out += "\"width\": " + std::to_string(codes.width) + ",\n";
+    out += "\"rows\": " + std::to_string(codes.rows) + ",\n";
+    if (codes.max_color_value != 255) {
+        out += "\"max_color_value\": " + std::to_string(codes.max_color_value) + ",\n";
+    }
+    if (codes.filtered) {
+        out += "\"filter\": \"png\",\n";
+    }
+    for (size_t i = 0; i < codes.planes.size() && i < std::size(PLANE_NAMES); i++) {
+        out += i == 0 ? "\"" : ",\n\"";
+        out += PLANE_NAMES[i];
+        out += "\": \"";
+        const size_t offset = out.size();
+        out.resize(offset + base64_encoded_size(codes.planes[i].size()));
+        base64_encode(codes.planes[i].data(), codes.planes[i].size(), out.data() + offset);
+        out += "\"";
+    }
+    out += "\n}";
+}
+
+bool container_view::open(const uint8_t* data, size_t size) {
+    codes_ = image_codes();
+    container_header header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, CONTAINER_MAGIC, sizeof(header.magic)) != 0 || header.version != CONTAINER_VERSION
+        || (header.flags & ~CONTAINER_FILTERED) != 0
+        || header.max_color_value > 65535) {
+        return false;
+    }
+    if (header.num_planes > (size - sizeof(header)) / sizeof(container_plane)) {
+        return false;
+    }
+
+    codes_.width = header.width;
+    codes_.rows = header.rows;
+    codes_.max_color_value = header.max_color_value == 0 ? 255 : header.max_color_value;
+    codes_.filtered = header.flags & CONTAINER_FILTERED;
+    for (uint32_t i = 0; i < header.num_planes; i++) {
+        container_plane plane;
+        std::memcpy(&plane, data + sizeof(header) + i * sizeof(plane), sizeof(plane));
+        if (plane.offset > size || plane.size > size - plane.offset) {
+            codes_ = image_codes();
+            return false;
+        }
+        codes_.planes.emplace_back(data + plane.offset, plane.size);
+    }
+    return true;
+}
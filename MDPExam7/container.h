@@ -0,0 +1,75 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+ * Binary container of the PackBits codes of an image, meant to be mapped and used in place:
+ *   container_header
+ *   container_plane[num_planes]   where the codes of every plane are, offsets count from the start
+ *   the PackBits codes of the planes (with EOD), each starting at a multiple of CONTAINER_ALIGNMENT
+ * All integers are little endian, which is also the layout of the structs below.
+ */
+struct container_header
+{
+    char magic[4];        // CONTAINER_MAGIC
+    uint16_t version;     // CONTAINER_VERSION
+    uint16_t flags;       // CONTAINER_FILTERED
+    uint32_t width;
+    uint32_t rows;
+    uint32_t num_planes;
+    uint32_t max_color_value; // 0 for 255, the usual value of 8-bit images
+};
+
+struct container_plane
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+static_assert(sizeof(container_header) == 24 && sizeof(container_plane) == 16, "the structs are the file layout");
+static_assert(std::endian::native == std::endian::little, "the container is used in place");
+
+constexpr char CONTAINER_MAGIC[4] = {'M', 'D', 'P', '7'};
+constexpr uint16_t CONTAINER_VERSION = 1;
+constexpr uint16_t CONTAINER_FILTERED = 1; // every row starts with its PNG filter byte, see FilterRows
+constexpr size_t CONTAINER_ALIGNMENT = 8;
+
+// names of the planes in the JSON, in the order of image_codes::planes
+constexpr const char* PLANE_NAMES[] = {"red", "green", "blue", "red_low", "green_low", "blue_low"};
+
+// PackBits codes of the planes of an image (red, green, blue), pointing into whatever holds them. 16-bit images
+// (max_color_value > 255) have six byte planes: the high bytes of red, green and blue, then their low bytes.
+struct image_codes
+{
+    uint32_t width = 0, rows = 0;
+    uint32_t max_color_value = 255;
+    bool filtered = false;
+    std::vector<std::span<const uint8_t>> planes;
+};
+
+// Appends the container of codes to out.
+void WriteContainer(const image_codes& codes, std::string& out);
+// Appends the JSON of codes to out, with the planes base64 encoded.
+void WriteJSON(const image_codes& codes, std::string& out);
+
+// Checked read access to a container in memory, the planes are not copied.
+class container_view
+{
+    image_codes codes_;
+public:
+
+    // returns false if data does not hold a complete container
+    bool open(const uint8_t* data, size_t size);
+
+    const image_codes& codes() const { return codes_; }
+    uint32_t width() const { return codes_.width; }
+    uint32_t rows() const { return codes_.rows; }
+    bool filtered() const { return codes_.filtered; }
+    size_t num_planes() const { return codes_.planes.size(); }
+    std::span<const uint8_t> plane(size_t i) const { return codes_.planes[i]; }
+};
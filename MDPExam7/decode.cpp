@@ -0,0 +1,245 @@
+#include "decode.h"
+#include "base64.h"
+#include "compress.h"
+#include "filter.h"
+#include "mapped_file.h"
+#include "process_ppm.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// the fields of the JSON written by WriteJSON, the planes still base64 encoded
+struct json_image
+{
+    uint64_t width = 0, rows = 0, max_color_value = 255;
+    bool filtered = false;
+    std::array<std::string_view, std::size(PLANE_NAMES)> planes;
+    std::array<bool, std::size(PLANE_NAMES)> found{};
+};
+
+void skip_space(const char*& pos, const char* end) {
+    while (pos < end && (isspace(static_cast<unsigned char>(*pos)) || *pos == ',')) {
+        pos++;
+    }
+}
+
+bool parse_string(const char*& pos, const char* end, std::string_view& value) {
+    if (pos == end || *pos != '"') {
+        return false;
+    }
+    const char* begin = ++pos;
+    // neither the keys nor base64 need escapes
+    pos = static_cast<const char*>(std::memchr(pos, '"', end - pos));
+    if (pos == nullptr) {
+        return false;
+    }
+    value = std::string_view(begin, pos - begin);
+    pos++;
+    return true;
+}
+
+// a flat object of strings and non-negative numbers, exactly what WriteJSON produces
+bool parse_json(const char* pos, const char* end, json_image& image) {
+    skip_space(pos, end);
+    if (pos == end || *pos != '{') {
+        return false;
+    }
+    pos++;
+    while (true) {
+        skip_space(pos, end);
+        if (pos < end && *pos == '}') {
+            return true;
+        }
+        std::string_view key;
+        if (!parse_string(pos, end, key)) {
+            return false;
+        }
+        skip_space(pos, end);
+        if (pos == end || *pos != ':') {
+            return false;
+        }
+        pos++;
+        skip_space(pos, end);
+
+        if (pos < end && *pos == '"') {
+            std::string_view value;
+            if (!parse_string(pos, end, value)) {
+                return false;
+            }
+            if (key == "filter") {
+                if (value != "png") {
+                    return false;
+                }
+                image.filtered = true;
+            }
+            for (size_t plane = 0; plane < image.planes.size(); plane++) {
+                if (key == PLANE_NAMES[plane]) {
+                    image.planes[plane] = value;
+                    image.found[plane] = true;
+                }
+            }
+        } else {
+            uint64_t value = 0;
+            const char* digits = pos;
+            while (pos < end && isdigit(static_cast<unsigned char>(*pos)) && value <= UINT32_MAX) {
+                value = value * 10 + (*pos++ - '0');
+            }
+            if (pos == digits || value > UINT32_MAX) {
+                return false;
+            }
+            if (key == "width") {
+                image.width = value;
+            } else if (key == "rows") {
+                image.rows = value;
+            } else if (key == "max_color_value") {
+                image.max_color_value = value;
+            }
+        }
+    }
+}
+
+// codes of one plane, either raw (container) or base64 (JSON)
+struct plane_source
+{
+    std::span<const uint8_t> codes;
+    std::string_view base64;
+};
+
+bool decode_plane(const plane_source& source, bool filtered, mat<uint8_t>& plane) {
+    std::vector<uint8_t> decoded;
+    std::span<const uint8_t> codes = source.codes;
+    if (!source.base64.empty()) {
+        decoded.resize(base64_decoded_max_size(source.base64.size()));
+        size_t num_bytes;
+        if (!base64_decode(source.base64.data(), source.base64.size(), decoded.data(), num_bytes)) {
+            return false;
+        }
+        codes = std::span<const uint8_t>(decoded.data(), num_bytes);
+    }
+
+    if (!filtered) {
+        return PackBitsDecode(codes.data(), codes.size(), plane.data(), plane.size());
+    }
+    mat<uint8_t> rows(plane.rows(), plane.cols() + 1);
+    return PackBitsDecode(codes.data(), codes.size(), rows.data(), rows.size())
+        && UnfilterRows(rows.view(), nullptr, plane.view());
+}
+
+// the planes are expanded on a thread each
+bool decode_planes(uint32_t width, uint32_t rows, bool filtered, const std::vector<plane_source>& sources,
+                   std::vector<mat<uint8_t>>& planes) {
+    // as in ParsePPMHeader, a plane with the filter byte in front of every row has to fit the int sizes of mat
+    if (width == 0 || rows == 0 || (uint64_t{width} + 1) * rows > INT32_MAX) {
+        return false;
+    }
+    planes.resize(sources.size());
+    std::vector<char> ok(sources.size());
+    std::vector<std::thread> workers;
+    for (size_t plane = 0; plane < sources.size(); plane++) {
+        planes[plane].resize(rows, width);
+        workers.emplace_back([&, plane] { ok[plane] = decode_plane(sources[plane], filtered, planes[plane]); });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    return std::all_of(ok.begin(), ok.end(), [](char plane_ok) { return plane_ok; });
+}
+
+bool decode_planes(uint32_t width, uint32_t rows, bool filtered, const std::vector<plane_source>& sources, mat<vec3b>& img) {
+    std::vector<mat<uint8_t>> planes;
+    if (sources.size() != 3 || !decode_planes(width, rows, filtered, sources, planes)) {
+        return false;
+    }
+    MergeRGB(planes[0], planes[1], planes[2], img);
+    return true;
+}
+
+// the high bytes of red, green and blue, then their low bytes
+bool decode_planes(uint32_t width, uint32_t rows, bool filtered, const std::vector<plane_source>& sources, mat<vec3w>& img) {
+    std::vector<mat<uint8_t>> planes;
+    if (sources.size() != 6 || !decode_planes(width, rows, filtered, sources, planes)) {
+        return false;
+    }
+    std::array<mat<uint16_t>, 3> samples;
+    for (size_t channel = 0; channel < 3; channel++) {
+        samples[channel].resize(rows, width);
+        MergeBytes(planes[channel].view(), planes[3 + channel].view(), samples[channel].view());
+    }
+    MergeRGB(samples[0], samples[1], samples[2], img);
+    return true;
+}
+
+std::vector<plane_source> container_sources(const image_codes& codes) {
+    std::vector<plane_source> sources(codes.planes.size());
+    for (size_t plane = 0; plane < sources.size(); plane++) {
+        sources[plane].codes = codes.planes[plane];
+    }
+    return sources;
+}
+
+}
+
+bool DecodeImage(const image_codes& codes, mat<vec3b>& img) {
+    return codes.max_color_value <= 255 && decode_planes(codes.width, codes.rows, codes.filtered, container_sources(codes), img);
+}
+
+bool DecodeImage(const image_codes& codes, mat<vec3w>& img) {
+    return codes.max_color_value > 255 && decode_planes(codes.width, codes.rows, codes.filtered, container_sources(codes), img);
+}
+
+bool DecodeFile(const std::string& input, const std::string& output) {
+    mapped_file file;
+    if (!file.open(input)) {
+        std::cerr << "Cannot open " << input << std::endl;
+        return false;
+    }
+
+    // the planes of both formats end up in an image_codes, JSON planes with their base64 in sources
+    image_codes codes;
+    std::vector<plane_source> sources;
+    bool decoded;
+    if (file.size() >= sizeof(CONTAINER_MAGIC) && std::memcmp(file.data(), CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) == 0) {
+        container_view container;
+        decoded = container.open(file.data(), file.size());
+        codes = container.codes();
+        sources = container_sources(codes);
+    } else {
+        json_image image;
+        const char* text = reinterpret_cast<const char*>(file.data());
+        decoded = parse_json(text, text + file.size(), image) && image.width <= UINT32_MAX && image.rows <= UINT32_MAX
+            && image.max_color_value > 0 && image.max_color_value <= 65535;
+        const size_t num_planes = image.max_color_value > 255 ? 6 : 3;
+        for (size_t plane = 0; decoded && plane < num_planes; plane++) {
+            decoded = image.found[plane];
+            sources.emplace_back();
+            sources.back().base64 = image.planes[plane];
+        }
+        codes.width = image.width;
+        codes.rows = image.rows;
+        codes.max_color_value = image.max_color_value;
+        codes.filtered = image.filtered;
+    }
+
+    if (decoded && codes.max_color_value > 255) {
+        mat<vec3w> img;
+        if (decode_planes(codes.width, codes.rows, codes.filtered, sources, img)) {
+            return WritePPM(output, img, codes.max_color_value);
+        }
+    } else if (decoded) {
+        mat<vec3b> img;
+        if (decode_planes(codes.width, codes.rows, codes.filtered, sources, img)) {
+            return WritePPM(output, img, codes.max_color_value);
+        }
+    }
+    std::cerr << "Cannot decode " << input << std::endl;
+    return false;
+}
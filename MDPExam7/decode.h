@@ -0,0 +1,18 @@
+#pragma once
+
+#include "container.h"
+#include "mat.h"
+#include "ppm.h"
+
+#include <string>
+
+// Expands the PackBits codes of the three planes (on a thread each), undoes the row filters and interleaves them.
+bool DecodeImage(const image_codes& codes, mat<vec3b>& img);
+// The same for 16-bit images, whose six byte planes are joined to 16-bit samples first.
+bool DecodeImage(const image_codes& codes, mat<vec3w>& img);
+
+/*
+ * Turns the output of MDPExam7, JSON or container (told apart by the magic), back into a PPM file. The input is
+ * mapped: container planes are used in place, the base64 of JSON planes is decoded by the plane threads.
+ */
+bool DecodeFile(const std::string& input, const std::string& output);
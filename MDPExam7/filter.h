@@ -0,0 +1,31 @@
+#pragma once
+
+#include "mat.h"
+
+#include <cstddef>
+#include <cstdint>
+
+// the PNG filter types, predicting every byte from its left (a), upper (b) and upper left (c) neighbour
+enum class row_filter : uint8_t
+{
+    none = 0,
+    sub = 1,      // a
+    up = 2,       // b
+    average = 3,  // (a + b) / 2
+    paeth = 4,    // whichever of a, b, c is closest to a + b - c
+};
+constexpr int NUM_ROW_FILTERS = 5;
+
+// out[i] = row[i] - prediction[i], prev is the row above (all zeros for the first row)
+void filter_row(row_filter filter, const uint8_t* row, const uint8_t* prev, uint8_t* out, size_t n);
+// inverse of filter_row, in place: row holds the filtered bytes and prev the already restored row above
+void unfilter_row(row_filter filter, uint8_t* row, const uint8_t* prev, size_t n);
+
+/*
+ * Filters every row with the filter whose residuals repeat the most, which usually leaves the fewest PackBits
+ * bytes, and writes it PNG style, as the filter byte followed by the filtered row, so filtered has one
+ * column more than rows. prev_row is the row above the first one, nullptr at the top of the image.
+ */
+void FilterRows(mat_view<const uint8_t> rows, const uint8_t* prev_row, mat_view<uint8_t> filtered);
+// inverse of FilterRows, returns false on an unknown filter byte
+bool UnfilterRows(mat_view<const uint8_t> filtered, const uint8_t* prev_row, mat_view<uint8_t> rows);
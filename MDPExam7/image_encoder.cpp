@@ -0,0 +1,82 @@
+#include "image_encoder.h"
+#include "base64.h"
+#include "compress.h"
+#include "container.h"
+#include "mapped_file.h"
+#include "process_ppm.h"
+
+#include <iostream>
+
+namespace {
+
+// the key and the base64 of codes, written straight into the reserved json
+void append_plane(std::string& json, const char* key, const std::vector<uint8_t>& codes, const char* end) {
+    json += key;
+    const size_t offset = json.size();
+    json.resize(offset + base64_encoded_size(codes.size()));
+    base64_encode(codes.data(), codes.size(), json.data() + offset);
+    json += end;
+}
+
+}
+
+const std::string& ImageEncoder::JSON(const std::string& filename) {
+    json_.clear();
+    // the planes are split straight from the mapped file, as in the batch mode
+    mapped_file file;
+    ppm_header header;
+    if (!file.open(filename)) {
+        std::cerr << "Cannot open image file " << filename << std::endl;
+        json_ = "{}";
+        return json_;
+    }
+    if (!ParsePPMHeader(file.data(), file.size(), header, filename)) {
+        json_ = "{}";
+        return json_;
+    }
+
+    const int rows = header.height, cols = header.width;
+    const size_t num_planes = NumBytePlanes(header);
+    for (size_t plane = 0; plane < num_planes; plane++) {
+        planes_[plane].resize(rows, cols);
+    }
+    if (num_planes == 3) {
+        SplitRGB(PPMPixels(file.data(), header), planes_[0].view(), planes_[1].view(), planes_[2].view());
+    } else {
+        for (auto& samples : samples_) {
+            samples.resize(rows, cols);
+        }
+        SplitRGB16BE(PPMPayload(file.data(), header), samples_[0].view(), samples_[1].view(), samples_[2].view());
+        for (size_t channel = 0; channel < 3; channel++) {
+            SplitBytes(samples_[channel].view(), planes_[channel].view(), planes_[3 + channel].view());
+        }
+    }
+
+    size_t num_chars = 192; // the keys and the numbers
+    for (size_t plane = 0; plane < num_planes; plane++) {
+        encoded_[plane].clear();
+        PackBitsEncode(planes_[plane], encoded_[plane]);
+        num_chars += base64_encoded_size(encoded_[plane].size());
+    }
+    json_.reserve(num_chars);
+
+    json_ += "{\n";
+    // appended piece by piece, the numbers alone fit into std::string without allocating
+    json_ += "\t\"width\": ";
+    json_ += std::to_string(cols);
+    json_ += ",\n\t\"rows\": ";
+    json_ += std::to_string(rows);
+    json_ += ",\n";
+    if (header.max_color_value != 255) {
+        json_ += "\t\"max_color_value\": ";
+        json_ += std::to_string(header.max_color_value);
+        json_ += ",\n";
+    }
+    for (size_t plane = 0; plane < num_planes; plane++) {
+        json_ += "\t\"";
+        json_ += PLANE_NAMES[plane];
+        append_plane(json_, "\": \"", encoded_[plane], plane + 1 < num_planes ? "\",\n" : "\"\n");
+    }
+    json_ += "}";
+    return json_;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include "mat.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * Encodes PPM images to the JSON of JSON() one after the other, keeping the samples, the planes, the PackBits codes
+ * and the output between calls. Once they have grown to the largest image seen, encoding an image does no heap
+ * allocation. An encoder is not shared between threads, every worker owns one.
+ * 16-bit images are encoded in six byte planes like in the other outputs, see NumBytePlanes.
+ */
+class ImageEncoder
+{
+    std::array<mat<uint16_t>, 3> samples_; // of 16-bit images
+    std::array<mat<uint8_t>, 6> planes_;
+    std::array<std::vector<uint8_t>, 6> encoded_;
+    std::string json_;
+
+public:
+    // The JSON of the image, "{}" if it cannot be loaded. It stays valid until the next call.
+    const std::string& JSON(const std::string& filename);
+
+    // Moves the last JSON out, the next call has to grow the output again.
+    std::string ReleaseJSON() { return std::move(json_); }
+};
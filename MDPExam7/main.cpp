@@ -1,35 +1,71 @@
-#include "process_ppm.h"
-#include "compress.h"
-#include "mat.h"
-#include <cassert>
+#include "batch.h"
+#include "decode.h"
+#include "pipeline.h"
+#include <cstdlib>
 #include <string>
 #include <iostream>
+#include <vector>
 
+// MDPExam7 [--filter] [--container] [--stats|--stats=hw] <image.ppm> <unused>
+// MDPExam7 --decode <image.json or image.mdp7> <image.ppm>
+// MDPExam7 --batch [--filter] [--container] [--threads N] [--output-dir DIR] <image.ppm or directory>...
 int main(int argc, char *argv[]) {
-    assert(argc == 3);
-    std::string filename = argv[1];
-    mat<vec3b> img;
-    LoadPPM(filename, img);
-
-    std::vector<mat<uint8_t >> planes(3);
-    SplitRGB(img, planes[0], planes[1], planes[2]);
-
-    std::vector<std::vector<uint8_t>> packbits_encoded;
-    for (size_t plane = 0; plane < planes.size(); plane++) {
-        std::vector<uint8_t> packbit_codes;
-        PackBitsEncode(planes[plane], packbit_codes);
-        packbits_encoded.push_back(packbit_codes);
+    bool batch = false, decode = false;
+    batch_options options;
+    stats_mode mode = stats_mode::off;
+    std::vector<std::string> paths;
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        if (arg == "--batch") {
+            batch = true;
+        } else if (arg == "--decode") {
+            decode = true;
+        } else if (arg == "--filter") {
+            options.filter = true;
+        } else if (arg == "--container") {
+            options.container = true;
+        } else if (arg == "--threads" && i + 1 < argc) {
+            options.num_threads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--output-dir" && i + 1 < argc) {
+            options.output_dir = argv[++i];
+        } else if (parse_stats_option(arg, mode)) {
+            continue;
+        } else {
+            paths.push_back(arg);
+        }
     }
 
-    std::string json = "{\n";
-    json += "\"width\": " + std::to_string(img.cols()) + ",\n";
-    json += "\"rows\": " + std::to_string(img.rows()) + ",\n";
-    json += "\"red\": \"" + Base64Encode(packbits_encoded[0]) + "\",\n";
-    json += "\"green\": \"" + Base64Encode(packbits_encoded[1]) + "\",\n";
-    json += "\"blue\": \"" + Base64Encode(packbits_encoded[2]) + "\",\n";
-    json += "}";
+    if (batch) {
+        const auto inputs = CollectInputs(paths);
+        if (inputs.empty()) {
+            std::cerr << "No input images" << std::endl;
+            return 1;
+        }
+        return RunBatch(inputs, options) ? 0 : 1;
+    }
 
-    std::cout << json << std::endl;
+    if (paths.size() != 2) {
+        std::cerr << "Usage: " << argv[0] << " [--filter] [--container] [--stats|--stats=hw] <image.ppm> <unused>" << std::endl;
+        std::cerr << "       " << argv[0] << " --decode <image.json or image.mdp7> <image.ppm>" << std::endl;
+        std::cerr << "       " << argv[0] << " --batch [--filter] [--container] [--threads N] [--output-dir DIR] <image.ppm or directory>..." << std::endl;
+        return 1;
+    }
+    if (decode) {
+        return DecodeFile(paths[0], paths[1]) ? 0 : 1;
+    }
+    std::string filename = paths[0];
+    const auto stats = make_codec_stats(options.container ? "mdp7_container" : "mdp7_json", mode);
+    const bool encoded = options.container ? StreamContainer(filename, std::cout, options.filter, stats.get())
+                                           : StreamJSON(filename, std::cout, options.filter, stats.get());
+    if (!encoded) {
+        return 1;
+    }
+    if (!options.container) {
+        std::cout << std::endl;
+    }
+    if (stats) {
+        stats->write_json(std::cerr);
+    }
 
     return 0;
 }
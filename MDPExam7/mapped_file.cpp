@@ -0,0 +1,36 @@
+#include "mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool mapped_file::open(const std::string& filename) {
+    close();
+    const int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st{};
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+    void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd); // the mapping keeps the file referenced
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+    data_ = static_cast<const uint8_t*>(data);
+    size_ = st.st_size;
+    return true;
+}
+
+void mapped_file::close() {
+    if (data_ != nullptr) {
+        munmap(const_cast<uint8_t*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+}
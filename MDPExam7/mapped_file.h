@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Read-only memory mapping of a whole file, unmapped when the object is destroyed.
+class mapped_file
+{
+    const uint8_t* data_ = nullptr;
+    size_t size_ = 0;
+public:
+
+    mapped_file() = default;
+    explicit mapped_file(const std::string& filename) { open(filename); }
+    ~mapped_file() { close(); }
+
+    mapped_file(const mapped_file&) = delete;
+    mapped_file& operator=(const mapped_file&) = delete;
+    mapped_file(mapped_file&& other) noexcept : data_(other.data_), size_(other.size_)
+    {
+        other.data_ = nullptr;
+        other.size_ = 0;
+    }
+    mapped_file& operator=(mapped_file&& other) noexcept
+    {
+        if (this != &other) {
+            close();
+            data_ = other.data_;
+            size_ = other.size_;
+            other.data_ = nullptr;
+            other.size_ = 0;
+        }
+        return *this;
+    }
+
+    // maps the file, the pages are hinted for sequential access. Empty files cannot be mapped
+    bool open(const std::string& filename);
+    void close();
+
+    bool is_open() const { return data_ != nullptr; }
+    const uint8_t* data() const { return data_; }
+    size_t size() const { return size_; }
+};
@@ -1,59 +1,207 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
-#include <vector>
 #include <cassert>
+#include <cstddef>
 #include <iterator>
+#include <memory>
+#include <new>
+#include <numeric>
+#include <type_traits>
+#include <utility>
 
+// alignment of the storage of every mat, enough for any vector load
+constexpr size_t MAT_ALIGNMENT = 64;
+
+// Non-owning window on rows x cols elements, rows start stride elements apart. It can refer to a mat, a part of
+// it or any external buffer such as a memory mapped file. Use mat_view<const T> for read only access.
+template <typename T>
+class mat_view
+{
+    T* data_;
+    int rows_, cols_, stride_;
+public:
+
+    mat_view(T* data = nullptr, int rows = 0, int cols = 0, int stride = -1)
+        : data_(data), rows_(rows), cols_(cols), stride_(stride < 0 ? cols : stride)
+    {
+        assert(rows >= 0 && cols >= 0 && stride_ >= cols);
+    }
+
+    // views on T convert to views on const T
+    template <typename U, typename = std::enable_if_t<std::is_same_v<const U, T>>>
+    mat_view(const mat_view<U>& other) : mat_view(other.data(), other.rows(), other.cols(), other.stride()) {}
+
+    int rows() const { return rows_; }
+    int cols() const { return cols_; }
+    int stride() const { return stride_; }
+    int size() const { return rows_ * cols_; }
+    // the rows follow each other without padding, so the elements can be processed as one array
+    bool is_contiguous() const { return stride_ == cols_ || rows_ <= 1; }
+
+    T& operator()(int r, int c) const
+    {
+        assert(r >= 0 && c >= 0 && r < rows_ && c < cols_);
+        return data_[static_cast<size_t>(r)*stride_ + c];
+    }
+
+    T* data() const { return data_; }
+    T* row(int r) const
+    {
+        assert(r >= 0 && r < rows_);
+        return data_ + static_cast<size_t>(r)*stride_;
+    }
+
+    mat_view sub(int r, int c, int rows, int cols) const
+    {
+        assert(r >= 0 && c >= 0 && rows >= 0 && cols >= 0 && r + rows <= rows_ && c + cols <= cols_);
+        return mat_view(data_ + static_cast<size_t>(r)*stride_ + c, rows, cols, stride_);
+    }
+};
+
+/*
+ * Image owning its elements. The storage is aligned to MAT_ALIGNMENT and resize does not initialize trivial
+ * elements, as they are usually overwritten right away. Rows are contiguous unless a larger stride is asked for.
+ */
 template <typename T>
 class mat
 {
-    int rows_, cols_;
-    std::vector<T> data_;
+    static constexpr bool trivial = std::is_trivially_copyable_v<T> && std::is_trivially_destructible_v<T>;
+
+    int rows_ = 0, cols_ = 0, stride_ = 0;
+    size_t capacity_ = 0;
+    T* data_ = nullptr;
+
+    void release()
+    {
+        if (data_ != nullptr) {
+            if constexpr (!trivial) {
+                std::destroy_n(data_, capacity_);
+            }
+            ::operator delete(data_, std::align_val_t{MAT_ALIGNMENT});
+        }
+        data_ = nullptr;
+        capacity_ = 0;
+    }
+
 public:
 
     mat(int rows = 0, int cols = 0)
     {
         resize(rows, cols);
     }
+    ~mat() { release(); }
+
+    mat(const mat& other)
+    {
+        *this = other;
+    }
+    mat& operator=(const mat& other)
+    {
+        if (this != &other) {
+            resize(other.rows_, other.cols_, other.stride_);
+            for (int r = 0; r < rows_; r++) {
+                std::copy_n(other.row(r), cols_, row(r));
+            }
+        }
+        return *this;
+    }
+    mat(mat&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+    mat& operator=(mat&& other) noexcept
+    {
+        if (this != &other) {
+            release();
+            rows_ = std::exchange(other.rows_, 0);
+            cols_ = std::exchange(other.cols_, 0);
+            stride_ = std::exchange(other.stride_, 0);
+            capacity_ = std::exchange(other.capacity_, 0);
+            data_ = std::exchange(other.data_, nullptr);
+        }
+        return *this;
+    }
+
+    // smallest stride >= cols that starts every row on a MAT_ALIGNMENT boundary
+    static int aligned_stride(int cols)
+    {
+        constexpr size_t step = MAT_ALIGNMENT / std::gcd(MAT_ALIGNMENT, sizeof(T));
+        return static_cast<int>((cols + step - 1) / step * step);
+    }
 
-    void resize(int rows, int cols)
+    // the previous contents are not kept, the storage is only reallocated when it grows
+    void resize(int rows, int cols, int stride = -1)
     {
-        assert(rows >= 0 && cols >= 0);
+        if (stride < 0) {
+            stride = cols;
+        }
+        assert(rows >= 0 && cols >= 0 && stride >= cols);
         rows_ = rows;
         cols_ = cols;
-        data_.resize(rows*cols);
+        stride_ = stride;
+
+        const size_t needed = static_cast<size_t>(rows)*stride;
+        if (needed > capacity_) {
+            release();
+            data_ = static_cast<T*>(::operator new(needed*sizeof(T), std::align_val_t{MAT_ALIGNMENT}));
+            capacity_ = needed;
+            if constexpr (!trivial) {
+                std::uninitialized_default_construct_n(data_, capacity_);
+            }
+        }
     }
 
     int rows() const { return rows_; }
     int cols() const { return cols_; }
+    int stride() const { return stride_; }
+    bool is_contiguous() const { return stride_ == cols_ || rows_ <= 1; }
 
     T& operator()(int r, int c)
     {
         assert(r >= 0 && c >= 0 && r < rows_ && c < cols_);
-        return data_[r*cols_ + c];
+        return data_[static_cast<size_t>(r)*stride_ + c];
     }
     const T& operator()(int r, int c) const
     {
         assert(r >= 0 && c >= 0 && r < rows_ && c < cols_);
-        return data_[r*cols_ + c];
+        return data_[static_cast<size_t>(r)*stride_ + c];
     }
 
-    T* data() { return data_.data(); }
-    const T* data() const { return data_.data(); }
+    T* row(int r)
+    {
+        assert(r >= 0 && r < rows_);
+        return data_ + static_cast<size_t>(r)*stride_;
+    }
+    const T* row(int r) const
+    {
+        assert(r >= 0 && r < rows_);
+        return data_ + static_cast<size_t>(r)*stride_;
+    }
+
+    mat_view<T> view() { return mat_view<T>(data_, rows_, cols_, stride_); }
+    mat_view<const T> view() const { return mat_view<const T>(data_, rows_, cols_, stride_); }
+    mat_view<T> sub(int r, int c, int rows, int cols) { return view().sub(r, c, rows, cols); }
+    mat_view<const T> sub(int r, int c, int rows, int cols) const { return view().sub(r, c, rows, cols); }
+
+    // the flat accessors below treat the elements as one array and need contiguous rows
+    T* data() { return data_; }
+    const T* data() const { return data_; }
     int size() const { return rows_ * cols_; }
 
-    char* rawdata() { return reinterpret_cast<char*>(data_.data()); }
-    const char* rawdata() const { return reinterpret_cast<const char*>(data_.data()); }
-    int rawsize() const { return rows_ * cols_ * sizeof(T); }
+    char* rawdata() { return reinterpret_cast<char*>(data_); }
+    const char* rawdata() const { return reinterpret_cast<const char*>(data_); }
+    size_t rawsize() const { assert(is_contiguous()); return static_cast<size_t>(rows_) * cols_ * sizeof(T); }
 
-    auto begin() { return data_.begin(); }
-    auto begin() const { return data_.begin(); }
-    auto end() { return data_.end(); }
-    auto end() const { return data_.end(); }
+    T* begin() { assert(is_contiguous()); return data_; }
+    const T* begin() const { assert(is_contiguous()); return data_; }
+    T* end() { assert(is_contiguous()); return data_ + size(); }
+    const T* end() const { assert(is_contiguous()); return data_ + size(); }
 
 	template <typename Iter>
 	void assign(Iter first, Iter last) {
-		data_.assign(first, last);
+		assert(is_contiguous() && std::distance(first, last) == size());
+		std::copy(first, last, data_);
 	}
 };
@@ -0,0 +1,231 @@
+#include "pipeline.h"
+#include "bounded_queue.h"
+#include "compress.h"
+#include "container.h"
+#include "filter.h"
+#include "mapped_file.h"
+#include "mat.h"
+#include "process_ppm.h"
+#include "stream_encoder.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr size_t STRIP_BYTES = 1 << 16;  // plane bytes per strip, a strip holds whole rows
+constexpr size_t QUEUE_CAPACITY = 4;     // strips in flight per plane
+
+using strip = mat<uint8_t>;
+
+using packet_sink = std::function<void(const std::vector<uint8_t>& packets)>;
+
+// Encodes the strips of one plane, filtered first if asked to. The packets go to sink as they are produced,
+// the last call has the EOD. With stats, the filter and PackBits time of the strips and the packets are recorded.
+void encode_plane(bounded_queue<strip>& queue, bool filter, const packet_sink& sink, codec_stats* stats) {
+    packbits_counts counts;
+    PackBitsStream packbits(stats ? &counts : nullptr);
+    std::vector<uint8_t> packets;
+    strip rows, filtered;
+    std::vector<uint8_t> prev_row; // last row of the previous strip
+    while (queue.pop(rows)) {
+        auto start = stats ? stats_clock::now() : stats_clock::time_point{};
+        const strip* coded = &rows;
+        if (filter) {
+            filtered.resize(rows.rows(), rows.cols() + 1);
+            FilterRows(rows.view(), prev_row.empty() ? nullptr : prev_row.data(), filtered.view());
+            prev_row.assign(rows.row(rows.rows() - 1), rows.row(rows.rows() - 1) + rows.cols());
+            coded = &filtered;
+            if (stats) {
+                stats->add_stage("filter", start, rows.size(), filtered.size());
+                start = stats_clock::now();
+            }
+        }
+        packets.clear();
+        packbits.write(coded->data(), coded->size(), packets);
+        if (stats) {
+            stats->add_stage("packbits", start, coded->size(), packets.size());
+        }
+        sink(packets);
+    }
+    const auto start = stats ? stats_clock::now() : stats_clock::time_point{};
+    packets.clear();
+    packbits.finish(packets);
+    if (stats) {
+        stats->add_stage("packbits", start, 0, packets.size());
+        counts.report(*stats);
+    }
+    sink(packets);
+}
+
+bool open_image(const std::string& filename, mapped_file& file, ppm_header& header) {
+    if (!file.open(filename)) {
+        std::cerr << "Cannot open image file " << filename << std::endl;
+        return false;
+    }
+    return ParsePPMHeader(file.data(), file.size(), header, filename);
+}
+
+// splits the image strip by strip, the planes are encoded on a thread each
+void encode_planes(const mapped_file& file, const ppm_header& header, bool filter, const std::vector<packet_sink>& sinks,
+                   codec_stats* stats) {
+    const size_t n = sinks.size();
+    assert(n == NumBytePlanes(header));
+    std::deque<bounded_queue<strip>> queues;
+    std::vector<std::thread> workers;
+    for (size_t plane = 0; plane < n; plane++) {
+        queues.emplace_back(QUEUE_CAPACITY);
+        workers.emplace_back(encode_plane, std::ref(queues[plane]), filter, std::cref(sinks[plane]), stats);
+    }
+
+    const int width = header.width, height = header.height;
+    const int rows_per_strip = std::max<int>(1, STRIP_BYTES / width);
+    std::array<mat<uint16_t>, 3> samples; // the 16-bit planes of a strip, before their bytes are split
+    for (int row = 0; row < height; row += rows_per_strip) {
+        const auto start = stats ? stats_clock::now() : stats_clock::time_point{};
+        const int num_rows = std::min(rows_per_strip, height - row);
+        std::array<strip, 6> planes;
+        for (size_t plane = 0; plane < n; plane++) {
+            planes[plane].resize(num_rows, width);
+        }
+        if (n == 3) {
+            const auto rows = PPMPixels(file.data(), header).sub(row, 0, num_rows, width);
+            SplitRGB(rows, planes[0].view(), planes[1].view(), planes[2].view());
+        } else {
+            const auto rows = PPMPayload(file.data(), header).sub(row, 0, num_rows, 6 * width);
+            for (auto& s : samples) {
+                s.resize(num_rows, width);
+            }
+            SplitRGB16BE(rows, samples[0].view(), samples[1].view(), samples[2].view());
+            for (size_t channel = 0; channel < 3; channel++) {
+                SplitBytes(samples[channel].view(), planes[channel].view(), planes[3 + channel].view());
+            }
+        }
+        if (stats) {
+            stats->add_stage("split", start, n * num_rows * width, n * num_rows * width);
+        }
+        for (size_t plane = 0; plane < n; plane++) {
+            queues[plane].push(std::move(planes[plane]));
+        }
+    }
+
+    for (auto& queue : queues) {
+        queue.close();
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+}
+
+bool StreamJSON(const std::string& filename, std::ostream& os, bool filter, codec_stats* stats) {
+    const auto start = stats ? stats_clock::now() : stats_clock::time_point{};
+    mapped_file file;
+    ppm_header header;
+    if (!open_image(filename, file, header)) {
+        return false;
+    }
+    const size_t n = NumBytePlanes(header);
+    if (stats) {
+        stats->add_stage("load", start, file.size(), n * static_cast<uint64_t>(header.width) * header.height);
+    }
+
+    os << "{\n";
+    os << "\"width\": " << header.width << ",\n";
+    os << "\"rows\": " << header.height << ",\n";
+    if (header.max_color_value != 255) {
+        os << "\"max_color_value\": " << header.max_color_value << ",\n";
+    }
+    if (filter) {
+        os << "\"filter\": \"png\",\n";
+    }
+    os << "\"" << PLANE_NAMES[0] << "\": \"";
+
+    // red is written while it is encoded, the other planes follow it in the output, so they wait in memory
+    std::vector<Base64Stream> base64(n);
+    std::vector<std::string> encoded(n);
+    std::vector<packet_sink> sinks(n);
+    for (size_t plane = 0; plane < n; plane++) {
+        sinks[plane] = [&, plane](const std::vector<uint8_t>& packets) {
+            const auto start = stats ? stats_clock::now() : stats_clock::time_point{};
+            const size_t num_chars = encoded[plane].size();
+            base64[plane].write(packets.data(), packets.size(), encoded[plane]);
+            if (stats) {
+                stats->add_stage("base64", start, packets.size(), encoded[plane].size() - num_chars);
+            }
+            if (plane == 0 && encoded[plane].size() >= STRIP_BYTES) {
+                os.write(encoded[plane].data(), encoded[plane].size());
+                encoded[plane].clear();
+            }
+        };
+    }
+    encode_planes(file, header, filter, sinks, stats);
+    for (size_t plane = 0; plane < n; plane++) {
+        base64[plane].finish(encoded[plane]);
+    }
+
+    const auto write_start = stats ? stats_clock::now() : stats_clock::time_point{};
+    os << encoded[0] << "\"";
+    for (size_t plane = 1; plane < n; plane++) {
+        os << ",\n\"" << PLANE_NAMES[plane] << "\": \"" << encoded[plane] << "\"";
+    }
+    os << "\n}";
+    if (stats) {
+        size_t num_chars = 0;
+        for (const auto& chars : encoded) {
+            num_chars += chars.size();
+        }
+        stats->add_stage("write", write_start, num_chars, num_chars);
+    }
+    return true;
+}
+
+bool StreamContainer(const std::string& filename, std::ostream& os, bool filter, codec_stats* stats) {
+    const auto start = stats ? stats_clock::now() : stats_clock::time_point{};
+    mapped_file file;
+    ppm_header header;
+    if (!open_image(filename, file, header)) {
+        return false;
+    }
+    const size_t n = NumBytePlanes(header);
+    if (stats) {
+        stats->add_stage("load", start, file.size(), n * static_cast<uint64_t>(header.width) * header.height);
+    }
+
+    // the offset table comes first, so the planes are collected before anything is written
+    std::vector<std::vector<uint8_t>> encoded(n);
+    std::vector<packet_sink> sinks(n);
+    for (size_t plane = 0; plane < n; plane++) {
+        sinks[plane] = [&, plane](const std::vector<uint8_t>& packets) {
+            encoded[plane].insert(encoded[plane].end(), packets.begin(), packets.end());
+        };
+    }
+    encode_planes(file, header, filter, sinks, stats);
+
+    const auto write_start = stats ? stats_clock::now() : stats_clock::time_point{};
+    image_codes codes;
+    codes.width = header.width;
+    codes.rows = header.height;
+    codes.max_color_value = header.max_color_value;
+    codes.filtered = filter;
+    codes.planes.assign(encoded.begin(), encoded.end());
+    std::string container;
+    WriteContainer(codes, container);
+    os.write(container.data(), container.size());
+    if (stats) {
+        size_t num_bytes = 0;
+        for (const auto& bytes : encoded) {
+            num_bytes += bytes.size();
+        }
+        stats->add_stage("write", write_start, num_bytes, container.size());
+    }
+    return true;
+}
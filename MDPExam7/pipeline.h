@@ -0,0 +1,19 @@
+#pragma once
+
+#include "codec_stats.hpp"
+
+#include <ostream>
+#include <string>
+
+/*
+ * Writes the JSON of a PPM image (width, rows and the base64 encoded PackBits codes of the three planes) to os
+ * in one pass over the file: strips of rows are split into planes, which are encoded on one thread per plane.
+ * With filter, the rows go through FilterRows before PackBits and the JSON says "filter": "png".
+ * 16-bit images (max_color_value > 255) are split into six byte planes, see image_codes.
+ * With stats, the time and bytes of every stage (summed over the plane threads) and the PackBits packets are recorded.
+ * Returns false if the image cannot be loaded, in which case nothing is written.
+ */
+bool StreamJSON(const std::string& filename, std::ostream& os, bool filter = false, codec_stats* stats = nullptr);
+
+// Same as StreamJSON, but writes the binary container (see container.h) of the image.
+bool StreamContainer(const std::string& filename, std::ostream& os, bool filter = false, codec_stats* stats = nullptr);
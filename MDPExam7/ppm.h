@@ -19,5 +19,6 @@ struct vec
 };
 
 using vec3b = vec<uint8_t, 3>;
+using vec3w = vec<uint16_t, 3>;
 
 std::istream& operator>>(std::istream& is, vec3b& v);
@@ -2,95 +2,339 @@
 // Created by aloeser on 11.07.21.
 //
 
-//#include "process_ppm.h"
-
+#include "process_ppm.h"
+#include "mapped_file.h"
 #include "mat.h"
 #include "ppm.h"
+#include "rgb.h"
+
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
-#include <fstream>
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
 #include <iostream>
+#include <vector>
 
-template <typename T>
-std::istream& raw_read(std::istream& is, T& num, size_t size = sizeof(T)) {
-    return is.read(reinterpret_cast<char*>(&num), size);
+// skips whitespace and comments (from # to the end of the line) between the header fields
+static void skip_whitespace(const uint8_t*& pos, const uint8_t* end) {
+    while (pos < end) {
+        if (isspace(*pos)) {
+            pos++;
+        } else if (*pos == '#') {
+            while (pos < end && *pos != '\n') {
+                pos++;
+            }
+        } else {
+            break;
+        }
+    }
 }
 
-void skip_comment(std::istream& is) {
-    while (isspace(is.peek())) {
-        is.get();
+static bool parse_header_value(const uint8_t*& pos, const uint8_t* end, uint32_t& value) {
+    skip_whitespace(pos, end);
+    if (pos == end || !isdigit(*pos)) {
+        return false;
     }
-    if (is.peek() == '#') {
-        std::cout << "found a comment";
-        while (is.peek() != '\n') {
-            is.get();
-        }
+    uint64_t result = 0;
+    while (pos < end && isdigit(*pos) && result <= UINT32_MAX) {
+        result = result * 10 + (*pos - '0');
+        pos++;
+    }
+    value = static_cast<uint32_t>(result);
+    return result <= UINT32_MAX;
+}
+
+bool ParsePPMHeader(const uint8_t* data, size_t size, ppm_header& header, const std::string& filename) {
+    const uint8_t* pos = data;
+    const uint8_t* end = data + size;
+
+    if (size < 2 || pos[0] != 'P' || pos[1] != '6') {
+        std::cerr << filename << " is not a binary PPM (P6) file" << std::endl;
+        return false;
+    }
+    pos += 2;
+    if (!parse_header_value(pos, end, header.width) || !parse_header_value(pos, end, header.height)
+        || !parse_header_value(pos, end, header.max_color_value)
+        || header.width == 0 || header.height == 0 || header.max_color_value == 0 || header.max_color_value > 65535) {
+        std::cerr << "Invalid PPM header in " << filename << std::endl;
+        return false;
     }
+    // mat and mat_view count elements in int: the bytes of a row (see PPMPayload) and a plane with a filter byte
+    // in front of every row have to fit
+    const size_t bytes_per_sample = header.max_color_value < 256 ? 1 : 2;
+    if (header.width > INT32_MAX / (3 * bytes_per_sample)
+        || (uint64_t{header.width} + 1) * header.height > INT32_MAX) {
+        std::cerr << "Image " << filename << " is too large" << std::endl;
+        return false;
+    }
+
+    // exactly one whitespace separates the header from the pixels
+    if (pos == end || !isspace(*pos)) {
+        std::cerr << "Invalid PPM header in " << filename << std::endl;
+        return false;
+    }
+    pos++;
+    header.payload_offset = pos - data;
+
+    if (static_cast<size_t>(end - pos) < size_t{header.width} * header.height * 3 * bytes_per_sample) {
+        std::cerr << "Truncated pixel data in " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+mat_view<const vec3b> PPMPixels(const uint8_t* data, const ppm_header& header) {
+    static_assert(sizeof(vec3b) == 3 && alignof(vec3b) == 1, "the pixels are used in their file layout");
+    assert(header.max_color_value < 256);
+    return mat_view<const vec3b>(reinterpret_cast<const vec3b*>(data + header.payload_offset), header.height, header.width);
+}
+
+size_t NumBytePlanes(const ppm_header& header) {
+    return header.max_color_value > 255 ? 6 : 3;
+}
+
+mat_view<const uint8_t> PPMPayload(const uint8_t* data, const ppm_header& header) {
+    const int bytes_per_sample = header.max_color_value < 256 ? 1 : 2;
+    return mat_view<const uint8_t>(data + header.payload_offset, header.height, 3 * bytes_per_sample * header.width);
 }
 
 bool LoadPPM(const std::string& filename, mat<vec3b>& img) {
-    std::ifstream is(filename);
-    if (!is) {
+    uint32_t max_color_value;
+    return LoadPPM(filename, img, max_color_value);
+}
+
+bool LoadPPM(const std::string& filename, mat<vec3b>& img, uint32_t& max_color_value) {
+    // the whole file is mapped, the header is parsed in place and the pixels are copied with a single memcpy
+    mapped_file file;
+    if (!file.open(filename)) {
         std::cerr << "Cannot open image file " << filename << std::endl;
         return false;
     }
-
-    std::string format;
-    is >> format;
-    assert(format == "P6");
-
-    // test.ppm contains a comment..
-    skip_comment(is);
-
-    uint32_t width, height, max_color_value;
-    is >> width >> height >> max_color_value;
-    assert(width > 0);
-    assert(height > 0);
-    img.resize(height,  width);
-
-    assert(max_color_value > 0 && max_color_value < 65536);
-    assert(max_color_value < 256); // otherwise we cannot use vec3b..
-
-    // erase whitespace
-    is.get();
-
-    const auto stream_position = is.tellg();
-    is.close();
-    is.open(filename, std::ios::binary);
-    is.seekg(stream_position);
-
-    size_t col = 0;
-    size_t row = 0;
-    size_t pixels_read = 0;
-    uint8_t r, g, b;
-    while (raw_read(is, r)) {
-        raw_read(is, g);
-        raw_read(is, b);
-        img(row, col) = {r, g, b};
-        col++;
-        if (col == width) {
-            col = 0;
-            row++;
-        }
-        pixels_read++;
+    ppm_header header;
+    if (!ParsePPMHeader(file.data(), file.size(), header, filename)) {
+        return false;
     }
-    assert(pixels_read == img.size());
+    if (header.max_color_value > 255) {
+        // otherwise we cannot use vec3b..
+        std::cerr << "Unsupported maximum color value " << header.max_color_value << " in " << filename << std::endl;
+        return false;
+    }
+    max_color_value = header.max_color_value;
+
+    // resize leaves the pixels uninitialized, they are written exactly once by the copy
+    img.resize(header.height, header.width);
+    std::memcpy(img.rawdata(), PPMPixels(file.data(), header).data(), img.rawsize());
 
     return true;
 }
 
+void SplitRGB(mat_view<const vec3b> img, mat_view<uint8_t> img_r, mat_view<uint8_t> img_g, mat_view<uint8_t> img_b) {
+    assert(img_r.rows() == img.rows() && img_g.rows() == img.rows() && img_b.rows() == img.rows());
+    assert(img_r.cols() == img.cols() && img_g.cols() == img.cols() && img_b.cols() == img.cols());
+
+    if (img.is_contiguous() && img_r.is_contiguous() && img_g.is_contiguous() && img_b.is_contiguous()) {
+        // the pixels are stored row after row, so the whole image is one linear stream of RGB triples
+        deinterleave_rgb(reinterpret_cast<const uint8_t*>(img.data()), img_r.data(), img_g.data(), img_b.data(), img.size());
+        return;
+    }
+    for (int r = 0; r < img.rows(); r++) {
+        deinterleave_rgb(reinterpret_cast<const uint8_t*>(img.row(r)), img_r.row(r), img_g.row(r), img_b.row(r), img.cols());
+    }
+}
+
 void SplitRGB(const mat<vec3b>& img, mat<uint8_t>& img_r, mat<uint8_t>& img_g, mat<uint8_t>& img_b) {
-    const auto cols = img.cols();
-    const auto rows = img.rows();
-
-    img_r.resize(rows, cols);
-    img_g.resize(rows, cols);
-    img_b.resize(rows, cols);
-    for (size_t col = 0; col < cols; col++) {
-        for (size_t row = 0; row < rows; row++) {
-            const auto& pixel = img(row, col);
-            img_r(row, col) = pixel[0];
-            img_g(row, col) = pixel[1];
-            img_b(row, col) = pixel[2];
+    img_r.resize(img.rows(), img.cols());
+    img_g.resize(img.rows(), img.cols());
+    img_b.resize(img.rows(), img.cols());
+    SplitRGB(img.view(), img_r.view(), img_g.view(), img_b.view());
+}
+
+void MergeRGB(mat_view<const uint8_t> img_r, mat_view<const uint8_t> img_g, mat_view<const uint8_t> img_b, mat_view<vec3b> img) {
+    assert(img_r.rows() == img.rows() && img_g.rows() == img.rows() && img_b.rows() == img.rows());
+    assert(img_r.cols() == img.cols() && img_g.cols() == img.cols() && img_b.cols() == img.cols());
+
+    if (img.is_contiguous() && img_r.is_contiguous() && img_g.is_contiguous() && img_b.is_contiguous()) {
+        interleave_rgb(img_r.data(), img_g.data(), img_b.data(), reinterpret_cast<uint8_t*>(img.data()), img.size());
+        return;
+    }
+    for (int r = 0; r < img.rows(); r++) {
+        interleave_rgb(img_r.row(r), img_g.row(r), img_b.row(r), reinterpret_cast<uint8_t*>(img.row(r)), img.cols());
+    }
+}
+
+void MergeRGB(const mat<uint8_t>& img_r, const mat<uint8_t>& img_g, const mat<uint8_t>& img_b, mat<vec3b>& img) {
+    assert(img_r.rows() == img_g.rows() && img_r.rows() == img_b.rows());
+    assert(img_r.cols() == img_g.cols() && img_r.cols() == img_b.cols());
+
+    img.resize(img_r.rows(), img_r.cols());
+    MergeRGB(img_r.view(), img_g.view(), img_b.view(), img.view());
+}
+
+// writes the header and the pixels with a single writev, repeated only if the kernel takes less
+static bool write_ppm(const std::string& filename, const std::string& header, const void* pixels, size_t size) {
+    const int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        std::cerr << "Cannot open output file " << filename << std::endl;
+        return false;
+    }
+    iovec parts[2] = {
+        {const_cast<char*>(header.data()), header.size()},
+        {const_cast<void*>(pixels), size},
+    };
+    iovec* part = parts;
+    int num_parts = 2;
+    while (num_parts > 0) {
+        const ssize_t written = writev(fd, part, num_parts);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+        size_t left = written;
+        while (num_parts > 0 && left >= part->iov_len) {
+            left -= part->iov_len;
+            part++;
+            num_parts--;
+        }
+        if (num_parts > 0) {
+            part->iov_base = static_cast<char*>(part->iov_base) + left;
+            part->iov_len -= left;
         }
     }
+    const bool ok = num_parts == 0;
+    if (::close(fd) != 0 || !ok) {
+        std::cerr << "Cannot write " << filename << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool WritePPM(const std::string& filename, const mat<vec3b>& img, uint32_t max_color_value) {
+    assert(max_color_value > 0 && max_color_value <= 255);
+    const std::string header = "P6\n" + std::to_string(img.cols()) + " " + std::to_string(img.rows()) + "\n"
+        + std::to_string(max_color_value) + "\n";
+    return write_ppm(filename, header, img.rawdata(), img.rawsize());
+}
+
+bool LoadPPM(const std::string& filename, mat<vec3w>& img, uint32_t& max_color_value) {
+    static_assert(sizeof(vec3w) == 6 && alignof(vec3w) == 2, "the pixels are three samples without padding");
+    mapped_file file;
+    if (!file.open(filename)) {
+        std::cerr << "Cannot open image file " << filename << std::endl;
+        return false;
+    }
+    ppm_header header;
+    if (!ParsePPMHeader(file.data(), file.size(), header, filename)) {
+        return false;
+    }
+    max_color_value = header.max_color_value;
+
+    img.resize(header.height, header.width);
+    const mat_view<const uint8_t> payload = PPMPayload(file.data(), header);
+    uint16_t* samples = reinterpret_cast<uint16_t*>(img.data());
+    const size_t num_samples = 3 * static_cast<size_t>(img.size());
+    if (header.max_color_value < 256) {
+        // 8-bit files are widened, so both kinds can go through the same code
+        std::copy_n(payload.data(), num_samples, samples);
+    } else {
+        // the file is big endian, the swap and the copy are one pass
+        swap_bytes16(payload.data(), reinterpret_cast<uint8_t*>(samples), num_samples);
+    }
+    return true;
+}
+
+bool WritePPM(const std::string& filename, const mat<vec3w>& img, uint32_t max_color_value) {
+    assert(max_color_value > 255 && max_color_value <= 65535);
+    const std::string header = "P6\n" + std::to_string(img.cols()) + " " + std::to_string(img.rows()) + "\n"
+        + std::to_string(max_color_value) + "\n";
+    std::vector<uint8_t> samples(img.rawsize());
+    swap_bytes16(reinterpret_cast<const uint8_t*>(img.rawdata()), samples.data(), samples.size() / 2);
+    return write_ppm(filename, header, samples.data(), samples.size());
+}
+
+void SplitRGB(mat_view<const vec3w> img, mat_view<uint16_t> img_r, mat_view<uint16_t> img_g, mat_view<uint16_t> img_b) {
+    assert(img_r.rows() == img.rows() && img_g.rows() == img.rows() && img_b.rows() == img.rows());
+    assert(img_r.cols() == img.cols() && img_g.cols() == img.cols() && img_b.cols() == img.cols());
+
+    if (img.is_contiguous() && img_r.is_contiguous() && img_g.is_contiguous() && img_b.is_contiguous()) {
+        deinterleave_rgb16(reinterpret_cast<const uint16_t*>(img.data()), img_r.data(), img_g.data(), img_b.data(), img.size());
+        return;
+    }
+    for (int r = 0; r < img.rows(); r++) {
+        deinterleave_rgb16(reinterpret_cast<const uint16_t*>(img.row(r)), img_r.row(r), img_g.row(r), img_b.row(r), img.cols());
+    }
+}
+
+void SplitRGB(const mat<vec3w>& img, mat<uint16_t>& img_r, mat<uint16_t>& img_g, mat<uint16_t>& img_b) {
+    img_r.resize(img.rows(), img.cols());
+    img_g.resize(img.rows(), img.cols());
+    img_b.resize(img.rows(), img.cols());
+    SplitRGB(img.view(), img_r.view(), img_g.view(), img_b.view());
+}
+
+void SplitRGB16BE(mat_view<const uint8_t> samples, mat_view<uint16_t> img_r, mat_view<uint16_t> img_g, mat_view<uint16_t> img_b) {
+    assert(img_r.rows() == samples.rows() && img_g.rows() == samples.rows() && img_b.rows() == samples.rows());
+    assert(samples.cols() == 6 * img_r.cols() && img_g.cols() == img_r.cols() && img_b.cols() == img_r.cols());
+
+    if (samples.is_contiguous() && img_r.is_contiguous() && img_g.is_contiguous() && img_b.is_contiguous()) {
+        deinterleave_rgb16be(samples.data(), img_r.data(), img_g.data(), img_b.data(), img_r.size());
+        return;
+    }
+    for (int r = 0; r < samples.rows(); r++) {
+        deinterleave_rgb16be(samples.row(r), img_r.row(r), img_g.row(r), img_b.row(r), img_r.cols());
+    }
+}
+
+void MergeRGB(mat_view<const uint16_t> img_r, mat_view<const uint16_t> img_g, mat_view<const uint16_t> img_b, mat_view<vec3w> img) {
+    assert(img_r.rows() == img.rows() && img_g.rows() == img.rows() && img_b.rows() == img.rows());
+    assert(img_r.cols() == img.cols() && img_g.cols() == img.cols() && img_b.cols() == img.cols());
+
+    if (img.is_contiguous() && img_r.is_contiguous() && img_g.is_contiguous() && img_b.is_contiguous()) {
+        interleave_rgb16(img_r.data(), img_g.data(), img_b.data(), reinterpret_cast<uint16_t*>(img.data()), img.size());
+        return;
+    }
+    for (int r = 0; r < img.rows(); r++) {
+        interleave_rgb16(img_r.row(r), img_g.row(r), img_b.row(r), reinterpret_cast<uint16_t*>(img.row(r)), img.cols());
+    }
+}
+
+void MergeRGB(const mat<uint16_t>& img_r, const mat<uint16_t>& img_g, const mat<uint16_t>& img_b, mat<vec3w>& img) {
+    assert(img_r.rows() == img_g.rows() && img_r.rows() == img_b.rows());
+    assert(img_r.cols() == img_g.cols() && img_r.cols() == img_b.cols());
+
+    img.resize(img_r.rows(), img_r.cols());
+    MergeRGB(img_r.view(), img_g.view(), img_b.view(), img.view());
+}
+
+void SplitBytes(mat_view<const uint16_t> plane, mat_view<uint8_t> high, mat_view<uint8_t> low) {
+    assert(high.rows() == plane.rows() && low.rows() == plane.rows());
+    assert(high.cols() == plane.cols() && low.cols() == plane.cols());
+
+    if (plane.is_contiguous() && high.is_contiguous() && low.is_contiguous()) {
+        split_bytes16(plane.data(), high.data(), low.data(), plane.size());
+        return;
+    }
+    for (int r = 0; r < plane.rows(); r++) {
+        split_bytes16(plane.row(r), high.row(r), low.row(r), plane.cols());
+    }
+}
+
+void MergeBytes(mat_view<const uint8_t> high, mat_view<const uint8_t> low, mat_view<uint16_t> plane) {
+    assert(high.rows() == plane.rows() && low.rows() == plane.rows());
+    assert(high.cols() == plane.cols() && low.cols() == plane.cols());
+
+    if (plane.is_contiguous() && high.is_contiguous() && low.is_contiguous()) {
+        merge_bytes16(high.data(), low.data(), plane.data(), plane.size());
+        return;
+    }
+    for (int r = 0; r < plane.rows(); r++) {
+        merge_bytes16(high.row(r), low.row(r), plane.row(r), plane.cols());
+    }
 }
\ No newline at end of file
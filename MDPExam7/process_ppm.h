@@ -6,5 +6,51 @@
 #include "ppm.h"
 #include "mat.h"
 
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct ppm_header
+{
+    uint32_t width, height, max_color_value;
+    size_t payload_offset; // bytes before the first pixel
+};
+
+// Parses the header of a binary PPM (P6) file held in memory, prints an error and returns false if the header
+// is malformed or the file is too short for the pixels it announces.
+bool ParsePPMHeader(const uint8_t* data, size_t size, ppm_header& header, const std::string& filename);
+
+// View on the 8-bit pixels of a PPM file held in memory (e.g. mapped), data is the start of the file.
+mat_view<const vec3b> PPMPixels(const uint8_t* data, const ppm_header& header);
+// Number of byte planes the image is encoded in: red, green and blue, 16-bit images (max_color_value > 255) have
+// the planes of their high bytes and then of their low bytes.
+size_t NumBytePlanes(const ppm_header& header);
+
+// View on the pixel bytes of a PPM file held in memory, a row holds 3 * width samples of 1 or 2 (big endian) bytes.
+mat_view<const uint8_t> PPMPayload(const uint8_t* data, const ppm_header& header);
+
+// 8-bit images (max_color_value <= 255), the maximum color value is kept so that it can be written back
 bool LoadPPM(const std::string& filename, mat<vec3b>& img);
-void SplitRGB(const mat<vec3b>& img, mat<uint8_t>& img_r, mat<uint8_t>& img_g, mat<uint8_t>& img_b);
\ No newline at end of file
+bool LoadPPM(const std::string& filename, mat<vec3b>& img, uint32_t& max_color_value);
+bool WritePPM(const std::string& filename, const mat<vec3b>& img, uint32_t max_color_value = 255);
+void SplitRGB(const mat<vec3b>& img, mat<uint8_t>& img_r, mat<uint8_t>& img_g, mat<uint8_t>& img_b);
+void MergeRGB(const mat<uint8_t>& img_r, const mat<uint8_t>& img_g, const mat<uint8_t>& img_b, mat<vec3b>& img);
+
+// the view versions work on views of equal size, e.g. strips of an image, and do not allocate
+void SplitRGB(mat_view<const vec3b> img, mat_view<uint8_t> img_r, mat_view<uint8_t> img_g, mat_view<uint8_t> img_b);
+void MergeRGB(mat_view<const uint8_t> img_r, mat_view<const uint8_t> img_g, mat_view<const uint8_t> img_b, mat_view<vec3b> img);
+
+// 16-bit images (max_color_value > 255), the samples are in native byte order in memory and big endian in the files
+bool LoadPPM(const std::string& filename, mat<vec3w>& img, uint32_t& max_color_value);
+bool WritePPM(const std::string& filename, const mat<vec3w>& img, uint32_t max_color_value);
+void SplitRGB(mat_view<const vec3w> img, mat_view<uint16_t> img_r, mat_view<uint16_t> img_g, mat_view<uint16_t> img_b);
+void MergeRGB(mat_view<const uint16_t> img_r, mat_view<const uint16_t> img_g, mat_view<const uint16_t> img_b, mat_view<vec3w> img);
+void SplitRGB(const mat<vec3w>& img, mat<uint16_t>& img_r, mat<uint16_t>& img_g, mat<uint16_t>& img_b);
+void MergeRGB(const mat<uint16_t>& img_r, const mat<uint16_t>& img_g, const mat<uint16_t>& img_b, mat<vec3w>& img);
+// splits rows of big endian samples as they are in the file (see PPMPayload), swapping the bytes on the way
+void SplitRGB16BE(mat_view<const uint8_t> samples, mat_view<uint16_t> img_r, mat_view<uint16_t> img_g, mat_view<uint16_t> img_b);
+
+// Splits a 16-bit plane into the planes of its high and its low bytes, which are encoded separately: the high
+// bytes change slowly and compress well even where the noisy low bytes do not.
+void SplitBytes(mat_view<const uint16_t> plane, mat_view<uint8_t> high, mat_view<uint8_t> low);
+void MergeBytes(mat_view<const uint8_t> high, mat_view<const uint8_t> low, mat_view<uint16_t> plane);
\ No newline at end of file
@@ -0,0 +1,397 @@
+#include "rgb.h"
+
+#include <array>
+#include <bit>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_SIMD 1
+#include <immintrin.h>
+#define SSSE3 __attribute__((target("ssse3")))
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace {
+
+/*
+ * The kernels work on bytes: S is the size of a sample (1 or 2), and with SWAP the bytes of every sample are
+ * reversed on the way, which turns big endian samples (PPM files) into native ones and back.
+ */
+template <size_t S, bool SWAP>
+void deinterleave_scalar(const uint8_t* rgb, uint8_t* r, uint8_t* g, uint8_t* b, size_t num_pixels) {
+    uint8_t* planes[3] = {r, g, b};
+    for (size_t i = 0; i < num_pixels; i++) {
+        for (size_t channel = 0; channel < 3; channel++) {
+            for (size_t k = 0; k < S; k++) {
+                planes[channel][S * i + k] = rgb[(3 * i + channel) * S + (SWAP ? S - 1 - k : k)];
+            }
+        }
+    }
+}
+
+template <size_t S, bool SWAP>
+void interleave_scalar(const uint8_t* r, const uint8_t* g, const uint8_t* b, uint8_t* rgb, size_t num_pixels) {
+    const uint8_t* planes[3] = {r, g, b};
+    for (size_t i = 0; i < num_pixels; i++) {
+        for (size_t channel = 0; channel < 3; channel++) {
+            for (size_t k = 0; k < S; k++) {
+                rgb[(3 * i + channel) * S + (SWAP ? S - 1 - k : k)] = planes[channel][S * i + k];
+            }
+        }
+    }
+}
+
+void swap_bytes16_scalar(const uint8_t* in, uint8_t* out, size_t num_samples) {
+    for (size_t i = 0; i < num_samples; i++) {
+        const uint8_t first = in[2 * i];
+        out[2 * i] = in[2 * i + 1];
+        out[2 * i + 1] = first;
+    }
+}
+
+void split_bytes16_scalar(const uint16_t* in, uint8_t* high, uint8_t* low, size_t num_samples) {
+    for (size_t i = 0; i < num_samples; i++) {
+        high[i] = static_cast<uint8_t>(in[i] >> 8);
+        low[i] = static_cast<uint8_t>(in[i]);
+    }
+}
+
+void merge_bytes16_scalar(const uint8_t* high, const uint8_t* low, uint16_t* out, size_t num_samples) {
+    for (size_t i = 0; i < num_samples; i++) {
+        out[i] = static_cast<uint16_t>(high[i] << 8 | low[i]);
+    }
+}
+
+#ifdef HAVE_X86_SIMD
+
+/*
+ * 48 bytes are three 16 byte registers, holding 16 pixels of 8-bit or 8 pixels of 16-bit samples. pshufb picks
+ * bytes by index, and an index with the high bit set produces 0, so every plane is the OR of three shuffles, one
+ * per register. masks[channel][source register][output byte]
+ */
+using shuffle_masks = std::array<std::array<std::array<int8_t, 16>, 3>, 3>;
+
+constexpr shuffle_masks make_deinterleave_masks(size_t sample_bytes, bool swap) {
+    shuffle_masks masks{};
+    for (size_t channel = 0; channel < 3; channel++) {
+        for (size_t source = 0; source < 3; source++) {
+            for (size_t i = 0; i < 16; i++) {
+                const size_t pixel = i / sample_bytes, k = i % sample_bytes;
+                const size_t byte = (3 * pixel + channel) * sample_bytes + (swap ? sample_bytes - 1 - k : k);
+                masks[channel][source][i] = byte / 16 == source ? static_cast<int8_t>(byte % 16) : -128;
+            }
+        }
+    }
+    return masks;
+}
+
+// masks[channel][output register][output byte]
+constexpr shuffle_masks make_interleave_masks(size_t sample_bytes, bool swap) {
+    shuffle_masks masks{};
+    for (size_t channel = 0; channel < 3; channel++) {
+        for (size_t target = 0; target < 3; target++) {
+            for (size_t i = 0; i < 16; i++) {
+                const size_t byte = 16 * target + i;
+                const size_t sample = byte / sample_bytes, k = byte % sample_bytes;
+                const size_t source = sample / 3 * sample_bytes + (swap ? sample_bytes - 1 - k : k);
+                masks[channel][target][i] = sample % 3 == channel ? static_cast<int8_t>(source) : -128;
+            }
+        }
+    }
+    return masks;
+}
+
+template <size_t S, bool SWAP>
+constexpr shuffle_masks deinterleave_masks = make_deinterleave_masks(S, SWAP);
+template <size_t S, bool SWAP>
+constexpr shuffle_masks interleave_masks = make_interleave_masks(S, SWAP);
+
+// reverses the two bytes of every 16-bit sample
+constexpr std::array<int8_t, 16> swap16_mask{1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14};
+// low bytes (even addresses) of 8 samples to the first half, their high bytes to the second
+constexpr std::array<int8_t, 16> split16_mask{0, 2, 4, 6, 8, 10, 12, 14, 1, 3, 5, 7, 9, 11, 13, 15};
+
+SSSE3 inline __m128i load_mask(const std::array<int8_t, 16>& mask) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i*>(mask.data()));
+}
+
+template <size_t S, bool SWAP>
+SSSE3 void deinterleave_ssse3(const uint8_t* rgb, uint8_t* r, uint8_t* g, uint8_t* b, size_t num_pixels) {
+    constexpr size_t P = 16 / S; // pixels per 48 bytes
+    uint8_t* planes[3] = {r, g, b};
+    size_t i = 0;
+    for (; i + P <= num_pixels; i += P) {
+        const uint8_t* pixels = rgb + 3 * S * i;
+        const __m128i in[3] = {
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 16)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(pixels + 32)),
+        };
+        for (int channel = 0; channel < 3; channel++) {
+            const auto& masks = deinterleave_masks<S, SWAP>[channel];
+            const __m128i plane = _mm_or_si128(_mm_or_si128(
+                    _mm_shuffle_epi8(in[0], load_mask(masks[0])),
+                    _mm_shuffle_epi8(in[1], load_mask(masks[1]))),
+                    _mm_shuffle_epi8(in[2], load_mask(masks[2])));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(planes[channel] + S * i), plane);
+        }
+    }
+    deinterleave_scalar<S, SWAP>(rgb + 3 * S * i, r + S * i, g + S * i, b + S * i, num_pixels - i);
+}
+
+template <size_t S, bool SWAP>
+SSSE3 void interleave_ssse3(const uint8_t* r, const uint8_t* g, const uint8_t* b, uint8_t* rgb, size_t num_pixels) {
+    constexpr size_t P = 16 / S;
+    const auto& masks = interleave_masks<S, SWAP>;
+    size_t i = 0;
+    for (; i + P <= num_pixels; i += P) {
+        const __m128i in[3] = {
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + S * i)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(g + S * i)),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + S * i)),
+        };
+        for (int target = 0; target < 3; target++) {
+            const __m128i out = _mm_or_si128(_mm_or_si128(
+                    _mm_shuffle_epi8(in[0], load_mask(masks[0][target])),
+                    _mm_shuffle_epi8(in[1], load_mask(masks[1][target]))),
+                    _mm_shuffle_epi8(in[2], load_mask(masks[2][target])));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(rgb + 3 * S * i + 16 * target), out);
+        }
+    }
+    interleave_scalar<S, SWAP>(r + S * i, g + S * i, b + S * i, rgb + 3 * S * i, num_pixels - i);
+}
+
+SSSE3 void swap_bytes16_ssse3(const uint8_t* in, uint8_t* out, size_t num_samples) {
+    const __m128i mask = load_mask(swap16_mask);
+    size_t i = 0;
+    for (; i + 8 <= num_samples; i += 8) {
+        const __m128i samples = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + 2 * i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 2 * i), _mm_shuffle_epi8(samples, mask));
+    }
+    swap_bytes16_scalar(in + 2 * i, out + 2 * i, num_samples - i);
+}
+
+SSSE3 void split_bytes16_ssse3(const uint16_t* in, uint8_t* high, uint8_t* low, size_t num_samples) {
+    const __m128i mask = load_mask(split16_mask);
+    size_t i = 0;
+    for (; i + 16 <= num_samples; i += 16) {
+        const __m128i a = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i)), mask);
+        const __m128i b = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i + 8)), mask);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(low + i), _mm_unpacklo_epi64(a, b));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(high + i), _mm_unpackhi_epi64(a, b));
+    }
+    split_bytes16_scalar(in + i, high + i, low + i, num_samples - i);
+}
+
+SSSE3 void merge_bytes16_ssse3(const uint8_t* high, const uint8_t* low, uint16_t* out, size_t num_samples) {
+    size_t i = 0;
+    for (; i + 16 <= num_samples; i += 16) {
+        const __m128i h = _mm_loadu_si128(reinterpret_cast<const __m128i*>(high + i));
+        const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(low + i));
+        // little endian: the low byte comes first
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_unpacklo_epi8(l, h));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + 8), _mm_unpackhi_epi8(l, h));
+    }
+    merge_bytes16_scalar(high + i, low + i, out + i, num_samples - i);
+}
+
+/*
+ * AVX2 shuffles only within 128 bit lanes, so the low lane handles the first 48 bytes and the high lane the
+ * next 48 with the same masks as the SSSE3 version.
+ */
+AVX2 inline __m256i load_mask2(const std::array<int8_t, 16>& mask) {
+    return _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(mask.data())));
+}
+
+AVX2 inline __m256i load_lanes(const uint8_t* low, const uint8_t* high) {
+    return _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(low))),
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(high)), 1);
+}
+
+template <size_t S, bool SWAP>
+AVX2 void deinterleave_avx2(const uint8_t* rgb, uint8_t* r, uint8_t* g, uint8_t* b, size_t num_pixels) {
+    constexpr size_t P = 32 / S; // pixels per 96 bytes
+    uint8_t* planes[3] = {r, g, b};
+    size_t i = 0;
+    for (; i + P <= num_pixels; i += P) {
+        const uint8_t* pixels = rgb + 3 * S * i;
+        const __m256i in[3] = {
+            load_lanes(pixels, pixels + 48),
+            load_lanes(pixels + 16, pixels + 64),
+            load_lanes(pixels + 32, pixels + 80),
+        };
+        for (int channel = 0; channel < 3; channel++) {
+            const auto& masks = deinterleave_masks<S, SWAP>[channel];
+            const __m256i plane = _mm256_or_si256(_mm256_or_si256(
+                    _mm256_shuffle_epi8(in[0], load_mask2(masks[0])),
+                    _mm256_shuffle_epi8(in[1], load_mask2(masks[1]))),
+                    _mm256_shuffle_epi8(in[2], load_mask2(masks[2])));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(planes[channel] + S * i), plane);
+        }
+    }
+    deinterleave_ssse3<S, SWAP>(rgb + 3 * S * i, r + S * i, g + S * i, b + S * i, num_pixels - i);
+}
+
+template <size_t S, bool SWAP>
+AVX2 void interleave_avx2(const uint8_t* r, const uint8_t* g, const uint8_t* b, uint8_t* rgb, size_t num_pixels) {
+    constexpr size_t P = 32 / S;
+    const auto& masks = interleave_masks<S, SWAP>;
+    size_t i = 0;
+    for (; i + P <= num_pixels; i += P) {
+        const __m256i in[3] = {
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(r + S * i)),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(g + S * i)),
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + S * i)),
+        };
+        uint8_t* pixels = rgb + 3 * S * i;
+        for (int target = 0; target < 3; target++) {
+            const __m256i out = _mm256_or_si256(_mm256_or_si256(
+                    _mm256_shuffle_epi8(in[0], load_mask2(masks[0][target])),
+                    _mm256_shuffle_epi8(in[1], load_mask2(masks[1][target]))),
+                    _mm256_shuffle_epi8(in[2], load_mask2(masks[2][target])));
+            // low lane: the first 48 bytes, high lane: the next 48
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 16 * target), _mm256_castsi256_si128(out));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 48 + 16 * target), _mm256_extracti128_si256(out, 1));
+        }
+    }
+    interleave_ssse3<S, SWAP>(r + S * i, g + S * i, b + S * i, rgb + 3 * S * i, num_pixels - i);
+}
+
+AVX2 void swap_bytes16_avx2(const uint8_t* in, uint8_t* out, size_t num_samples) {
+    const __m256i mask = load_mask2(swap16_mask);
+    size_t i = 0;
+    for (; i + 16 <= num_samples; i += 16) {
+        const __m256i samples = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + 2 * i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 2 * i), _mm256_shuffle_epi8(samples, mask));
+    }
+    swap_bytes16_ssse3(in + 2 * i, out + 2 * i, num_samples - i);
+}
+
+AVX2 void split_bytes16_avx2(const uint16_t* in, uint8_t* high, uint8_t* low, size_t num_samples) {
+    const __m256i mask = load_mask2(split16_mask);
+    size_t i = 0;
+    for (; i + 32 <= num_samples; i += 32) {
+        // every lane: 8 low bytes, then 8 high bytes
+        const __m256i a = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i)), mask);
+        const __m256i b = _mm256_shuffle_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + i + 16)), mask);
+        // the 64 bit halves come out in the order samples 0-7, 16-23, 8-15, 24-31
+        const __m256i l = _mm256_permute4x64_epi64(_mm256_unpacklo_epi64(a, b), 0b11011000);
+        const __m256i h = _mm256_permute4x64_epi64(_mm256_unpackhi_epi64(a, b), 0b11011000);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(low + i), l);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(high + i), h);
+    }
+    split_bytes16_ssse3(in + i, high + i, low + i, num_samples - i);
+}
+
+AVX2 void merge_bytes16_avx2(const uint8_t* high, const uint8_t* low, uint16_t* out, size_t num_samples) {
+    size_t i = 0;
+    for (; i + 32 <= num_samples; i += 32) {
+        const __m256i h = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(high + i));
+        const __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(low + i));
+        // per lane: a holds samples 0-7 and 16-23, b 8-15 and 24-31
+        const __m256i a = _mm256_unpacklo_epi8(l, h);
+        const __m256i b = _mm256_unpackhi_epi8(l, h);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_permute2x128_si256(a, b, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i + 16), _mm256_permute2x128_si256(a, b, 0x31));
+    }
+    merge_bytes16_ssse3(high + i, low + i, out + i, num_samples - i);
+}
+
+#endif
+
+template <size_t S, bool SWAP>
+void deinterleave(const uint8_t* rgb, uint8_t* r, uint8_t* g, uint8_t* b, size_t num_pixels) {
+#ifdef HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return deinterleave_avx2<S, SWAP>(rgb, r, g, b, num_pixels);
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return deinterleave_ssse3<S, SWAP>(rgb, r, g, b, num_pixels);
+    }
+#endif
+    deinterleave_scalar<S, SWAP>(rgb, r, g, b, num_pixels);
+}
+
+template <size_t S, bool SWAP>
+void interleave(const uint8_t* r, const uint8_t* g, const uint8_t* b, uint8_t* rgb, size_t num_pixels) {
+#ifdef HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return interleave_avx2<S, SWAP>(r, g, b, rgb, num_pixels);
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return interleave_ssse3<S, SWAP>(r, g, b, rgb, num_pixels);
+    }
+#endif
+    interleave_scalar<S, SWAP>(r, g, b, rgb, num_pixels);
+}
+
+const uint8_t* bytes(const uint16_t* samples) {
+    return reinterpret_cast<const uint8_t*>(samples);
+}
+
+uint8_t* bytes(uint16_t* samples) {
+    return reinterpret_cast<uint8_t*>(samples);
+}
+
+}
+
+void deinterleave_rgb(const uint8_t* rgb, uint8_t* r, uint8_t* g, uint8_t* b, size_t num_pixels) {
+    deinterleave<1, false>(rgb, r, g, b, num_pixels);
+}
+
+void interleave_rgb(const uint8_t* r, const uint8_t* g, const uint8_t* b, uint8_t* rgb, size_t num_pixels) {
+    interleave<1, false>(r, g, b, rgb, num_pixels);
+}
+
+void deinterleave_rgb16(const uint16_t* rgb, uint16_t* r, uint16_t* g, uint16_t* b, size_t num_pixels) {
+    deinterleave<2, false>(bytes(rgb), bytes(r), bytes(g), bytes(b), num_pixels);
+}
+
+void interleave_rgb16(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint16_t* rgb, size_t num_pixels) {
+    interleave<2, false>(bytes(r), bytes(g), bytes(b), bytes(rgb), num_pixels);
+}
+
+void deinterleave_rgb16be(const uint8_t* rgb, uint16_t* r, uint16_t* g, uint16_t* b, size_t num_pixels) {
+    static_assert(std::endian::native == std::endian::little, "the swap turns big endian into native samples");
+    deinterleave<2, true>(rgb, bytes(r), bytes(g), bytes(b), num_pixels);
+}
+
+void interleave_rgb16be(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint8_t* rgb, size_t num_pixels) {
+    interleave<2, true>(bytes(r), bytes(g), bytes(b), rgb, num_pixels);
+}
+
+void swap_bytes16(const uint8_t* in, uint8_t* out, size_t num_samples) {
+#ifdef HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return swap_bytes16_avx2(in, out, num_samples);
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return swap_bytes16_ssse3(in, out, num_samples);
+    }
+#endif
+    swap_bytes16_scalar(in, out, num_samples);
+}
+
+void split_bytes16(const uint16_t* in, uint8_t* high, uint8_t* low, size_t num_samples) {
+#ifdef HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return split_bytes16_avx2(in, high, low, num_samples);
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return split_bytes16_ssse3(in, high, low, num_samples);
+    }
+#endif
+    split_bytes16_scalar(in, high, low, num_samples);
+}
+
+void merge_bytes16(const uint8_t* high, const uint8_t* low, uint16_t* out, size_t num_samples) {
+#ifdef HAVE_X86_SIMD
+    if (__builtin_cpu_supports("avx2")) {
+        return merge_bytes16_avx2(high, low, out, num_samples);
+    }
+    if (__builtin_cpu_supports("ssse3")) {
+        return merge_bytes16_ssse3(high, low, out, num_samples);
+    }
+#endif
+    merge_bytes16_scalar(high, low, out, num_samples);
+}
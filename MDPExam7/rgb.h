@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Splits num_pixels interleaved RGB pixels (3 bytes each) into three planes.
+void deinterleave_rgb(const uint8_t* rgb, uint8_t* r, uint8_t* g, uint8_t* b, size_t num_pixels);
+
+// Inverse of deinterleave_rgb: combines three planes into interleaved RGB pixels.
+void interleave_rgb(const uint8_t* r, const uint8_t* g, const uint8_t* b, uint8_t* rgb, size_t num_pixels);
+
+// The same for 16-bit samples in native byte order.
+void deinterleave_rgb16(const uint16_t* rgb, uint16_t* r, uint16_t* g, uint16_t* b, size_t num_pixels);
+void interleave_rgb16(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint16_t* rgb, size_t num_pixels);
+
+// The same for 16-bit samples stored big endian as in PPM files, swapped to native order in the same pass.
+void deinterleave_rgb16be(const uint8_t* rgb, uint16_t* r, uint16_t* g, uint16_t* b, size_t num_pixels);
+void interleave_rgb16be(const uint16_t* r, const uint16_t* g, const uint16_t* b, uint8_t* rgb, size_t num_pixels);
+
+// Reverses the two bytes of every 16-bit sample (big endian <-> native), in and out may be the same.
+void swap_bytes16(const uint8_t* in, uint8_t* out, size_t num_samples);
+
+// Splits 16-bit samples into a plane of their high and one of their low bytes, and back.
+void split_bytes16(const uint16_t* in, uint8_t* high, uint8_t* low, size_t num_samples);
+void merge_bytes16(const uint8_t* high, const uint8_t* low, uint16_t* out, size_t num_samples);
@@ -0,0 +1,41 @@
+# Round trip check run by ctest:
+# cmake -DMDP7=<MDPExam7> -DINPUT=<image.ppm> -DWORK=<dir> [-DOPTIONS=--filter,--container] [-DEXPECTED=<file>]
+#       [-DCOMMENTED=ON] [-DJSON_TOOL=<MDPExam7Json>] -P round_trip.cmake
+# INPUT is encoded, decoded back into a PPM and encoded again. Both encodings have to be identical,
+# and identical to EXPECTED if given, so changes of the format itself are caught as well.
+# The decoded PPM has to be identical to INPUT, unless the header of INPUT has comments (COMMENTED), which are lost.
+# With JSON_TOOL, the image is encoded by that instead of MDP7 (OPTIONS do not apply), MDP7 still decodes it.
+
+file(MAKE_DIRECTORY ${WORK})
+string(REPLACE "," ";" OPTIONS "${OPTIONS}")
+
+function(run)
+    execute_process(COMMAND ${ARGN} RESULT_VARIABLE result ERROR_VARIABLE error)
+    if (NOT result EQUAL 0)
+        string(JOIN " " command ${ARGN})
+        message(FATAL_ERROR "${command} failed (${result}): ${error}")
+    endif ()
+endfunction()
+
+function(encode input output)
+    if (DEFINED JSON_TOOL)
+        set(command ${JSON_TOOL} ${input})
+    else ()
+        set(command ${MDP7} ${OPTIONS} ${input} unused)
+    endif ()
+    execute_process(COMMAND ${command} OUTPUT_FILE ${output} RESULT_VARIABLE result ERROR_VARIABLE error)
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "Encoding ${input} failed (${result}): ${error}")
+    endif ()
+endfunction()
+
+encode(${INPUT} ${WORK}/encoded)
+run(${MDP7} --decode ${WORK}/encoded ${WORK}/decoded.ppm)
+encode(${WORK}/decoded.ppm ${WORK}/reencoded)
+run(${CMAKE_COMMAND} -E compare_files ${WORK}/encoded ${WORK}/reencoded)
+if (NOT COMMENTED)
+    run(${CMAKE_COMMAND} -E compare_files ${INPUT} ${WORK}/decoded.ppm)
+endif ()
+if (DEFINED EXPECTED)
+    run(${CMAKE_COMMAND} -E compare_files ${EXPECTED} ${WORK}/encoded)
+endif ()
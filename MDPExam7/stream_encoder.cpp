@@ -0,0 +1,59 @@
+#include "stream_encoder.h"
+#include "base64.h"
+#include "compress.h"
+
+#include <algorithm>
+
+void PackBitsStream::write(const uint8_t* data, size_t num_bytes, std::vector<uint8_t>& encoded) {
+    pending_.insert(pending_.end(), data, data + num_bytes);
+    if (pending_.size() < PACKBITS_LOOKAHEAD) {
+        return;
+    }
+
+    // a packet starting before stop sees all the bytes it could depend on
+    const uint8_t* begin = pending_.data();
+    const uint8_t* end = begin + pending_.size();
+    const uint8_t* stop = end - (PACKBITS_LOOKAHEAD - 1);
+    const uint8_t* it = packbits_encode_packets(begin, stop, end, encoded, counts_);
+    pending_.erase(pending_.begin(), pending_.begin() + (it - begin));
+}
+
+void PackBitsStream::finish(std::vector<uint8_t>& encoded) {
+    const uint8_t* begin = pending_.data();
+    const uint8_t* end = begin + pending_.size();
+    packbits_encode_packets(begin, end, end, encoded, counts_);
+    pending_.clear();
+    encoded.push_back(128); // EOD
+}
+
+void Base64Stream::write(const uint8_t* data, size_t num_bytes, std::string& out) {
+    if (num_carry_ > 0) {
+        const size_t missing = std::min(3 - num_carry_, num_bytes);
+        std::copy(data, data + missing, carry_ + num_carry_);
+        num_carry_ += missing;
+        data += missing;
+        num_bytes -= missing;
+        if (num_carry_ < 3) {
+            return;
+        }
+        const size_t offset = out.size();
+        out.resize(offset + 4);
+        base64_encode_groups(carry_, 3, out.data() + offset);
+        num_carry_ = 0;
+    }
+
+    const size_t num_groups_bytes = num_bytes / 3 * 3;
+    const size_t offset = out.size();
+    out.resize(offset + base64_encoded_size(num_groups_bytes));
+    base64_encode_groups(data, num_groups_bytes, out.data() + offset);
+
+    num_carry_ = num_bytes - num_groups_bytes;
+    std::copy(data + num_groups_bytes, data + num_bytes, carry_);
+}
+
+void Base64Stream::finish(std::string& out) {
+    const size_t offset = out.size();
+    out.resize(offset + base64_encoded_size(num_carry_));
+    base64_encode(carry_, num_carry_, out.data() + offset);
+    num_carry_ = 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct packbits_counts;
+
+// PackBits encoder fed in pieces. It produces exactly the packets of PackBitsEncode on the concatenated input,
+// holding back only the bytes whose packets still depend on input that has not arrived yet.
+class PackBitsStream
+{
+    std::vector<uint8_t> pending_;
+    packbits_counts* counts_;
+
+public:
+    // with counts, the packets are counted there
+    explicit PackBitsStream(packbits_counts* counts = nullptr) : counts_(counts) {}
+
+    void write(const uint8_t* data, size_t num_bytes, std::vector<uint8_t>& encoded);
+    // encodes the remaining bytes and appends the EOD marker
+    void finish(std::vector<uint8_t>& encoded);
+};
+
+// Base64 encoder fed in pieces. Bytes are encoded in groups of 3, the at most 2 left over wait for the next
+// write, so the output equals Base64Encode on the concatenated input.
+class Base64Stream
+{
+    uint8_t carry_[3];
+    size_t num_carry_ = 0;
+
+public:
+    void write(const uint8_t* data, size_t num_bytes, std::string& out);
+    // encodes the left over bytes with padding
+    void finish(std::string& out);
+};
@@ -0,0 +1,99 @@
+#include "thread_pool.h"
+
+#include <algorithm>
+
+namespace {
+
+// the pool and the index of the worker running on this thread, if any
+thread_local const void* current_pool = nullptr;
+thread_local size_t current_index = 0;
+
+}
+
+thread_pool::thread_pool(size_t num_threads) {
+    if (num_threads == 0) {
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        queues_.push_back(std::make_unique<worker_queue>());
+    }
+    for (size_t i = 0; i < num_threads; i++) {
+        threads_.emplace_back(&thread_pool::run, this, i);
+    }
+}
+
+thread_pool::~thread_pool() {
+    wait();
+    {
+        std::lock_guard lock(mutex_);
+        stopping_ = true;
+    }
+    work_available_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void thread_pool::submit(std::function<void()> task) {
+    const size_t index = current_pool == this ? current_index : next_queue_++ % queues_.size();
+    pending_++;
+    {
+        // counted under the mutex, so a worker cannot miss it between checking and going to sleep.
+        // Counting before pushing keeps the count from dropping below zero, at worst a worker looks once too often
+        std::lock_guard lock(mutex_);
+        queued_++;
+    }
+    {
+        std::lock_guard lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+    }
+    work_available_.notify_one();
+}
+
+bool thread_pool::take(size_t index, std::function<void()>& task) {
+    for (size_t i = 0; i < queues_.size(); i++) {
+        const size_t victim = (index + i) % queues_.size();
+        std::lock_guard lock(queues_[victim]->mutex);
+        auto& tasks = queues_[victim]->tasks;
+        if (tasks.empty()) {
+            continue;
+        }
+        if (victim == index) {
+            task = std::move(tasks.back());
+            tasks.pop_back();
+        } else {
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        queued_--;
+        return true;
+    }
+    return false;
+}
+
+void thread_pool::run(size_t index) {
+    current_pool = this;
+    current_index = index;
+    std::function<void()> task;
+    while (true) {
+        if (take(index, task)) {
+            task();
+            task = nullptr;
+            if (--pending_ == 0) {
+                std::lock_guard lock(mutex_);
+                idle_.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock lock(mutex_);
+        work_available_.wait(lock, [this] { return queued_ > 0 || stopping_; });
+        if (stopping_ && queued_ == 0) {
+            return;
+        }
+    }
+}
+
+void thread_pool::wait() {
+    std::unique_lock lock(mutex_);
+    idle_.wait(lock, [this] { return pending_ == 0; });
+}
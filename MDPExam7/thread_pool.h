@@ -0,0 +1,52 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Work stealing thread pool: every worker has its own deque, takes its newest task first and steals the oldest
+ * task of another worker when its deque is empty. Tasks submitted by a worker go to its own deque, so a task
+ * that splits itself keeps the pieces local until someone is idle.
+ */
+class thread_pool
+{
+    struct worker_queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_queue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;
+    std::condition_variable work_available_, idle_;
+    std::atomic<size_t> queued_{0};   // submitted, not yet taken by a worker
+    std::atomic<size_t> pending_{0};  // submitted, not yet finished
+    std::atomic<size_t> next_queue_{0};
+    bool stopping_ = false;
+
+    bool take(size_t index, std::function<void()>& task);
+    void run(size_t index);
+
+public:
+    // 0 threads means one per hardware thread
+    explicit thread_pool(size_t num_threads = 0);
+    ~thread_pool();
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    size_t size() const { return threads_.size(); }
+
+    void submit(std::function<void()> task);
+    // blocks until every submitted task, including the ones submitted by tasks, has finished
+    void wait();
+};
@@ -0,0 +1,55 @@
+#include "packbits.hpp"
+
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <vector>
+
+void packbits(std::istream& is, std::ostream& os, const std::string& action, codec_stats* stats) {
+    using namespace std;
+    switch (action[0]) {
+        case 'c':
+            packbits_compress(is, os, stats);
+            break;
+        case 'd':
+            packbits_decompress(is, os, stats);
+            break;
+        default:
+            cout << "Invalid action: " << action << endl;
+            exit(EXIT_FAILURE);
+            break;
+    }
+}
+
+int main(int argc, char** argv) {
+    using namespace std;
+    stats_mode mode = stats_mode::off;
+    vector<string> args;
+    for (int i = 1; i < argc; i++) {
+        if (!parse_stats_option(argv[i], mode)) {
+            args.push_back(argv[i]);
+        }
+    }
+    if (args.size() != 3) {
+        cout << "Usage: packbits [--stats|--stats=hw] [c|d] <input file> <output file>\n";
+        exit(EXIT_FAILURE);
+    }
+    string action = args[0];
+    string in_file = args[1];
+    string out_file = args[2];
+    ifstream is(in_file, ios::binary);
+    if (!is) {
+        cout << "Unable to open file " << in_file << endl;
+        exit(EXIT_FAILURE);
+    }
+    ofstream os(out_file, ios::binary);
+    if (!os) {
+        cout << "Unable to open file " << out_file << endl;
+        exit(EXIT_FAILURE);
+    }
+    const auto stats = make_codec_stats(action[0] == 'c' ? "packbits_compress" : "packbits_decompress", mode);
+    packbits(is, os, action, stats.get());
+    if (stats) {
+        stats->write_json(cerr);
+    }
+}
\ No newline at end of file
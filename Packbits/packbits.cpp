@@ -1,10 +1,15 @@
+#include "packbits.hpp"
+
+#include <array>
+#include <cstdint>
 #include <iostream>
 #include <string>
-#include <fstream>
-#include <array>
+#include <utility>
 
 // todo: 128 bit, decomposition, optimization
 
+namespace {
+
 template<typename T>
 std::istream& raw_read(std::istream& is, T& num, size_t size = sizeof(T)) {
     return is.read(reinterpret_cast<char*>(&num), size);
@@ -15,9 +20,45 @@ std::ostream& raw_write(std::ostream& os, const T& num, size_t size = sizeof(T))
     return os.write(reinterpret_cast<const char*>(&num), size);
 }
 
-void packbits_compress(std::ifstream& is, std::ofstream& os) {
+// packet counts, only kept with STATS
+struct packet_counts {
+    uint64_t bytes_in = 0, bytes_out = 1; // EOD
+    uint64_t run_packets = 0, literal_packets = 0;
+    log2_histogram run_lengths, literal_lengths;
+
+    void run(int length) {
+        bytes_in += length;
+        bytes_out += 2;
+        run_packets++;
+        run_lengths.add(length);
+    }
+
+    void literal(int length) {
+        bytes_in += length;
+        bytes_out += 1 + length;
+        literal_packets++;
+        literal_lengths.add(length);
+    }
+
+    void report(codec_stats& stats, const std::string& stage, stats_clock::time_point start) const {
+        stats.add_stage(stage, start, bytes_in, bytes_out);
+        stats.count("run_packets", run_packets);
+        stats.count("literal_packets", literal_packets);
+        stats.add_histogram("run_length", run_lengths);
+        stats.add_histogram("literal_length", literal_lengths);
+    }
+};
+
+template <bool STATS>
+void compress(std::istream& is, std::ostream& os, codec_stats* stats) {
     using namespace std;
 
+    [[maybe_unused]] stats_clock::time_point start;
+    [[maybe_unused]] packet_counts counts;
+    if constexpr (STATS) {
+        start = stats_clock::now();
+    }
+
     // state machine
     int state = 0;
     int count = 0;
@@ -31,7 +72,13 @@ void packbits_compress(std::ifstream& is, std::ofstream& os) {
     // 5: done reading file
 
     // Setup state machine (initial state)
-    raw_read(is, curr);
+    if (!raw_read(is, curr)) {
+        raw_write(os, (uint8_t)128);
+        if constexpr (STATS) {
+            counts.report(*stats, "compress", start);
+        }
+        return;
+    }
     prev = curr;
     state = 1;
     count++;
@@ -47,9 +94,12 @@ void packbits_compress(std::ifstream& is, std::ofstream& os) {
                 count++;
                 break;
             case 2:
-                if (prev != curr) { // end of run condition
+                if (prev != curr || count == 128) { // end of run condition, or the longest run
                     raw_write(os, (uint8_t)(257 - count));
                     raw_write(os, prev);
+                    if constexpr (STATS) {
+                        counts.run(count);
+                    }
                     count = 0;
                     state = 1;
                 }
@@ -62,9 +112,24 @@ void packbits_compress(std::ifstream& is, std::ofstream& os) {
                     for (int i = 0; i < count - 1; ++i) {
                         raw_write(os, buff[i]);
                     }
+                    if constexpr (STATS) {
+                        counts.literal(count - 1);
+                    }
                     count = 2;
                     state = 2;
                 }
+                else if (count - 1 == 128) { // the copy is full, prev starts the next one
+                    raw_write(os, (uint8_t)127);
+                    for (int i = 0; i < 128; ++i) {
+                        raw_write(os, buff[i]);
+                    }
+                    if constexpr (STATS) {
+                        counts.literal(128);
+                    }
+                    buff[0] = prev;
+                    prev = curr;
+                    count = 2;
+                }
                 else {
                     buff[count - 1] = prev;
                     prev = curr;
@@ -75,57 +140,91 @@ void packbits_compress(std::ifstream& is, std::ofstream& os) {
     }
 
     if (state != 2) {
+        if (count - 1 == 128) {
+            raw_write(os, (uint8_t)127);
+            for (int i = 0; i < 128; ++i) {
+                raw_write(os, buff[i]);
+            }
+            if constexpr (STATS) {
+                counts.literal(128);
+            }
+            count = 1;
+        }
         buff[count - 1] = prev;
         count++;
         raw_write(os, (uint8_t)(count - 2));
         for (int i = 0; i < count - 1; ++i) {
             raw_write(os, buff[i]);
         }
+        if constexpr (STATS) {
+            counts.literal(count - 1);
+        }
     }
     else {
         raw_write(os, (uint8_t)(257 - count));
         raw_write(os, prev);
+        if constexpr (STATS) {
+            counts.run(count);
+        }
     }
     raw_write(os, (uint8_t)128);
+    if constexpr (STATS) {
+        counts.report(*stats, "compress", start);
+    }
 }
 
-void packbits_decompress(std::ifstream& is, std::ofstream& os) {
-}
+template <bool STATS>
+void decompress(std::istream& is, std::ostream& os, codec_stats* stats) {
+    [[maybe_unused]] stats_clock::time_point start;
+    [[maybe_unused]] packet_counts counts;
+    if constexpr (STATS) {
+        start = stats_clock::now();
+    }
 
-void packbits(std::ifstream& is, std::ofstream& os, const std::string& action) {
-    using namespace std;
-    switch (action[0]) {
-        case 'c':
-            packbits_compress(is, os);
-            break;
-        case 'd':
-            packbits_decompress(is, os);
-            break;
-        default:
-            cout << "Invalid action: " << action << endl;
-            exit(EXIT_FAILURE);
-            break;
+    std::array<uint8_t, 128> buff;
+    uint8_t length;
+    while (raw_read(is, length) && length != 128) { // 128 = EOD
+        if (length < 128) { // copy of length + 1 bytes
+            if (!raw_read(is, buff[0], length + 1)) {
+                break;
+            }
+            raw_write(os, buff[0], length + 1);
+            if constexpr (STATS) {
+                counts.literal(length + 1);
+            }
+        } else { // run of 257 - length times the next byte
+            uint8_t value;
+            if (!raw_read(is, value)) {
+                break;
+            }
+            buff.fill(value);
+            raw_write(os, buff[0], 257 - length);
+            if constexpr (STATS) {
+                counts.run(257 - length);
+            }
+        }
     }
-}
 
-int main(int argc, char** argv) {
-    using namespace std;
-    if (argc != 4) {
-        cout << "Usage: packbits [c|d] <input file> <output file>\n";
-        exit(EXIT_FAILURE);
+    if constexpr (STATS) {
+        // the counts are taken from the compressor side, so in and out swap
+        std::swap(counts.bytes_in, counts.bytes_out);
+        counts.report(*stats, "decompress", start);
     }
-    string action = argv[1];
-    string in_file = argv[2];
-    string out_file = argv[3];
-    ifstream is(in_file, ios::binary);
-    if (!is) {
-        cout << "Unable to open file " << in_file << endl;
-        exit(EXIT_FAILURE);
+}
+}
+
+void packbits_compress(std::istream& is, std::ostream& os, codec_stats* stats) {
+    if (stats) {
+        compress<true>(is, os, stats);
+    } else {
+        compress<false>(is, os, nullptr);
     }
-    ofstream os(out_file, ios::binary);
-    if (!os) {
-        cout << "Unable to open file " << out_file << endl;
-        exit(EXIT_FAILURE);
+}
+
+void packbits_decompress(std::istream& is, std::ostream& os, codec_stats* stats) {
+    if (stats) {
+        decompress<true>(is, os, stats);
+    } else {
+        decompress<false>(is, os, nullptr);
     }
-    packbits(is, os, action);
-}
\ No newline at end of file
+}
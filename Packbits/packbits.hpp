@@ -0,0 +1,11 @@
+#pragma once
+
+#include "codec_stats.hpp"
+
+#include <istream>
+#include <ostream>
+
+// PackBits codes of the whole stream, ending with EOD (128). With stats, the run and literal packets are recorded.
+void packbits_compress(std::istream& is, std::ostream& os, codec_stats* stats = nullptr);
+// expands PackBits codes up to EOD or the end of the stream
+void packbits_decompress(std::istream& is, std::ostream& os, codec_stats* stats = nullptr);
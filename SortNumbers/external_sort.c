@@ -0,0 +1,278 @@
+#include "external_sort.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "number_io.h"
+#include "parallel_sort.h"
+
+#define MAX_MERGE_WAYS 256 // more runs are merged in several passes, to stay below the open file limit
+#define MIN_RUN_BUFFER 4096 // numbers per run buffer during the merge
+
+/*
+ * Input side of the merge: a run file, read in large blocks
+ */
+typedef struct {
+    FILE *fp;
+    int *buffer;
+    size_t buffer_size;
+    size_t position;
+    size_t filled;
+} run_reader;
+
+/*
+ * Output side of the merge: either another run file (binary) or the final output (text)
+ */
+typedef struct {
+    FILE *run;
+    number_writer *writer;
+} merge_output;
+
+/*
+ * Tournament tree over the current head of every run. Every inner node stores the loser of the match played there,
+ * nodes[0] the overall winner, so replacing the winner only replays the matches on its path to the root:
+ * log2(k) comparisons per number, without the extra comparisons of a heap's sift down.
+ */
+typedef struct {
+    size_t num_runs;
+    size_t *nodes;
+    int *heads; // current number of every run
+    bool *exhausted;
+} loser_tree;
+
+static bool run_reader_fill(run_reader *reader) {
+    reader->filled = fread(reader->buffer, sizeof(int), reader->buffer_size, reader->fp);
+    reader->position = 0;
+    return reader->filled > 0;
+}
+
+// returns false if the run is exhausted
+static bool run_reader_next(run_reader *reader, int *number) {
+    if (reader->position == reader->filled && !run_reader_fill(reader)) {
+        return false;
+    }
+    *number = reader->buffer[reader->position++];
+    return true;
+}
+
+static inline bool loser_tree_less(const loser_tree *tree, size_t a, size_t b) {
+    if (tree->exhausted[a]) {
+        return false;
+    }
+    if (tree->exhausted[b]) {
+        return true;
+    }
+    return tree->heads[a] < tree->heads[b];
+}
+
+// plays all matches below node, returns the winner. Nodes >= num_runs are the leaves (runs)
+static size_t loser_tree_build(loser_tree *tree, size_t node) {
+    if (node >= tree->num_runs) {
+        return node - tree->num_runs;
+    }
+    size_t left = loser_tree_build(tree, 2 * node);
+    size_t right = loser_tree_build(tree, 2 * node + 1);
+    if (loser_tree_less(tree, left, right)) {
+        tree->nodes[node] = right;
+        return left;
+    }
+    tree->nodes[node] = left;
+    return right;
+}
+
+// the head of the winner changed, replay its matches up to the root
+static void loser_tree_replay(loser_tree *tree) {
+    size_t winner = tree->nodes[0];
+    for (size_t node = (winner + tree->num_runs) / 2; node > 0; node /= 2) {
+        if (loser_tree_less(tree, tree->nodes[node], winner)) {
+            size_t loser = winner;
+            winner = tree->nodes[node];
+            tree->nodes[node] = loser;
+        }
+    }
+    tree->nodes[0] = winner;
+}
+
+static bool flush_output(merge_output *output, const int *numbers, size_t num_numbers) {
+    if (output->writer != NULL) {
+        write_numbers(output->writer, numbers, num_numbers);
+        return true;
+    }
+    return fwrite(numbers, sizeof(int), num_numbers, output->run) == num_numbers;
+}
+
+/**
+ * k-way merge of the given (rewound) run files into output, using about buffer_numbers numbers of memory
+ */
+static bool merge_runs(FILE **runs, size_t num_runs, merge_output *output, size_t buffer_numbers) {
+    // one buffer per run plus one for the output
+    size_t run_buffer_size = buffer_numbers / (num_runs + 1);
+    if (run_buffer_size < MIN_RUN_BUFFER) {
+        run_buffer_size = MIN_RUN_BUFFER;
+    }
+
+    bool ok = true;
+    run_reader *readers = calloc(num_runs, sizeof(run_reader));
+    int *buffers = malloc(sizeof(int) * run_buffer_size * (num_runs + 1));
+    loser_tree tree = {
+        .num_runs = num_runs,
+        .nodes = malloc(sizeof(size_t) * num_runs),
+        .heads = malloc(sizeof(int) * num_runs),
+        .exhausted = malloc(sizeof(bool) * num_runs),
+    };
+    if (!readers || !buffers || !tree.nodes || !tree.heads || !tree.exhausted) {
+        fprintf(stderr, "Not enough memory for merging %zu runs\n", num_runs);
+        ok = false;
+        goto cleanup;
+    }
+
+    for (size_t run = 0; run < num_runs; run++) {
+        readers[run] = (run_reader) {
+            .fp = runs[run],
+            .buffer = buffers + run * run_buffer_size,
+            .buffer_size = run_buffer_size,
+        };
+        tree.exhausted[run] = !run_reader_next(&readers[run], &tree.heads[run]);
+    }
+    tree.nodes[0] = loser_tree_build(&tree, 1);
+
+    int *out = buffers + num_runs * run_buffer_size;
+    size_t out_filled = 0;
+    while (!tree.exhausted[tree.nodes[0]]) {
+        size_t winner = tree.nodes[0];
+        out[out_filled++] = tree.heads[winner];
+        if (out_filled == run_buffer_size) {
+            ok = ok && flush_output(output, out, out_filled);
+            out_filled = 0;
+        }
+        tree.exhausted[winner] = !run_reader_next(&readers[winner], &tree.heads[winner]);
+        loser_tree_replay(&tree);
+    }
+    ok = ok && flush_output(output, out, out_filled);
+
+    for (size_t run = 0; run < num_runs; run++) {
+        ok = ok && !ferror(runs[run]);
+    }
+
+cleanup:
+    free(readers);
+    free(buffers);
+    free(tree.nodes);
+    free(tree.heads);
+    free(tree.exhausted);
+    return ok;
+}
+
+bool external_sort(const char *infile, const char *outfile, size_t memory_budget, int num_threads, sort_function sort) {
+    // the sort of a run needs a scratch buffer of the same size, on several threads also the buffers of parallel_sort
+    size_t run_numbers = memory_budget / (2 * sizeof(int));
+    if (parallel_sort_threads(run_numbers, num_threads) > 1) {
+        run_numbers = memory_budget / (2 * sizeof(int) + PARALLEL_SORT_BYTES_PER_NUMBER);
+    }
+    if (run_numbers < MIN_RUN_BUFFER) {
+        run_numbers = MIN_RUN_BUFFER;
+    }
+
+    number_reader reader;
+    if (!number_reader_open(&reader, infile)) {
+        return false;
+    }
+    int *numbers = malloc(sizeof(int) * run_numbers);
+    FILE **runs = NULL;
+    size_t num_runs = 0;
+    size_t runs_capacity = 0;
+    bool ok = numbers != NULL;
+    if (!ok) {
+        fprintf(stderr, "Not enough memory for runs of %zu numbers\n", run_numbers);
+    }
+
+    // 1. create sorted runs
+    while (ok) {
+        size_t num_numbers = read_numbers_chunk(&reader, numbers, run_numbers);
+        if (num_runs == 0 && num_numbers < run_numbers) {
+            // everything fit into memory, no need for temporary files
+            number_reader_close(&reader);
+            parallel_sort(numbers, num_numbers, num_threads, sort);
+            ok = write_sorted_numbers(outfile, numbers, num_numbers);
+            free(numbers);
+            return ok;
+        }
+        if (num_numbers == 0) {
+            break;
+        }
+        parallel_sort(numbers, num_numbers, num_threads, sort);
+
+        if (num_runs == runs_capacity) {
+            runs_capacity = runs_capacity == 0 ? 16 : 2 * runs_capacity;
+            FILE **grown = realloc(runs, sizeof(FILE*) * runs_capacity);
+            if (grown == NULL) {
+                ok = false;
+                break;
+            }
+            runs = grown;
+        }
+        FILE *run = tmpfile(); // deleted automatically once closed
+        if (run == NULL || fwrite(numbers, sizeof(int), num_numbers, run) != num_numbers) {
+            fprintf(stderr, "Cannot write temporary file\n");
+            if (run != NULL) {
+                fclose(run);
+            }
+            ok = false;
+            break;
+        }
+        runs[num_runs++] = run;
+    }
+    number_reader_close(&reader);
+    free(numbers);
+
+    // 2. merge groups of runs into longer runs until one merge pass suffices
+    size_t buffer_numbers = memory_budget / sizeof(int);
+    while (ok && num_runs > MAX_MERGE_WAYS) {
+        size_t num_merged = 0;
+        for (size_t first = 0; ok && first < num_runs; first += MAX_MERGE_WAYS) {
+            size_t group = num_runs - first < MAX_MERGE_WAYS ? num_runs - first : MAX_MERGE_WAYS;
+            merge_output output = { .run = tmpfile(), .writer = NULL };
+            if (output.run == NULL) {
+                fprintf(stderr, "Cannot write temporary file\n");
+                ok = false;
+                break;
+            }
+            for (size_t run = first; run < first + group; run++) {
+                rewind(runs[run]);
+            }
+            ok = merge_runs(runs + first, group, &output, buffer_numbers);
+            for (size_t run = first; run < first + group; run++) {
+                fclose(runs[run]);
+                runs[run] = NULL;
+            }
+            runs[num_merged++] = output.run;
+        }
+        // close whatever is left after an error
+        for (size_t run = 0; run < num_runs; run++) {
+            if (run >= num_merged && runs[run] != NULL) {
+                fclose(runs[run]);
+            }
+        }
+        num_runs = num_merged;
+    }
+
+    // 3. final merge into the output file
+    if (ok) {
+        number_writer writer;
+        ok = number_writer_open(&writer, outfile, IO_BUFFER_SIZE);
+        if (ok) {
+            merge_output output = { .run = NULL, .writer = &writer };
+            for (size_t run = 0; run < num_runs; run++) {
+                rewind(runs[run]);
+            }
+            ok = merge_runs(runs, num_runs, &output, buffer_numbers);
+            ok = number_writer_close(&writer) && ok;
+        }
+    }
+
+    for (size_t run = 0; run < num_runs; run++) {
+        fclose(runs[run]);
+    }
+    free(runs);
+    return ok;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "sort.h"
+
+/**
+ * Sorts the numbers of infile into outfile while using roughly memory_budget bytes:
+ * the input is cut into runs that fit into the budget, every run is sorted in memory and spilled to a temporary file,
+ * and the runs are combined by a k-way merge (loser tree). Input that fits into a single run never touches the disk.
+ * @param infile
+ * @param outfile
+ * @param memory_budget in bytes
+ * @param num_threads threads used for sorting the runs, see parallel_sort
+ * @param sort sequential algorithm used for sorting the runs
+ * @return false on I/O errors
+ */
+bool external_sort(const char *infile, const char *outfile, size_t memory_budget, int num_threads, sort_function sort);
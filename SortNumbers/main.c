@@ -2,125 +2,223 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <ctype.h>
+#include <limits.h>
+#include <string.h>
 
-// Disclaimer: If done properly, there should be a .h file with declarations and in here only definitions, but I dont feel its worth the bother for a one file project
+#include "external_sort.h"
+#include "network_sort.h"
+#include "number_io.h"
+#include "parallel_sort.h"
+#include "select.h"
+#include "sort.h"
+
+// Disclaimer: the sorting algorithms live in sort.c, reading/writing in number_io.c, this file only contains the command line handling
 
 /**
- * Simple function to write the sorted numbers
- * @param filename
- * @param sorted_numbers
- * @param num_numbers
+ * parses sizes like 4096, 512K, 64M or 2G
+ * @param text
+ * @return the size in bytes, 0 if text is not a size
  */
-void write_sorted_numbers(const char *filename, int *sorted_numbers, int num_numbers) {
-    FILE *fp;
-    fp = fopen(filename, "w");
-    for (int i = 0; i < num_numbers ; i++) {
-        int sorted_number = sorted_numbers[i]; // pointers can be used in an array-like syntax
-        fprintf(fp, "%d\n", sorted_number);
+size_t parse_size(const char *text) {
+    char *end;
+    unsigned long long size = strtoull(text, &end, 10);
+    switch (toupper(*end)) {
+        case 'G': size <<= 10; // fallthrough
+        case 'M': size <<= 10; // fallthrough
+        case 'K': size <<= 10; end++; break;
+        case '\0': break;
+        default: return 0;
     }
-    fclose(fp);
+    return *end == '\0' ? size : 0;
 }
 
+#define MAX_PERCENTILES 64
+
+// instead of sorting, only answer a query
+const int query_none = 0;
+const int query_top = 1; // k largest numbers, largest first
+const int query_bottom = 2; // k smallest numbers, smallest first
+const int query_percentiles = 3; // one line "<percentile> <number>" per requested percentile
+
 /**
- * function to read whitespace-separated numbers from the given file name.
- * The function reads the input character wise.
- * The main loop for parsing a number is:
- *
- * num = 0
- * while (next char is number)
- *    number = number * 10 + next char
- * write num to the numbers array, num = 0
- *
- * The number of numbers is not known upfront, but tracked in num_numbers, which is given as a pointer (return value would work as well)
- * The array (== pointer) numbers has to be allocated by the functions caller, to avoid having to handle malloc/realloc/free
- * @param filename
- * @param numbers
- * @param num_numbers
+ * parses a comma separated list of percentiles, e.g. 50,90,99.9
+ * @param text
+ * @param percentiles array of MAX_PERCENTILES
+ * @return the number of percentiles, 0 if text is invalid
  */
-void read_numbers(const char *filename, int *numbers, int *num_numbers) {
-    FILE *fp = fopen(filename, "r");
-    // Input ends either on EOF or when encountering a format error, e.g., 34x, or a minus without a digit ("- ")
-    bool done = false;
-    bool negative = false;
+size_t parse_percentiles(const char *text, double *percentiles) {
+    size_t num_percentiles = 0;
+    while (num_percentiles < MAX_PERCENTILES) {
+        char *end;
+        double percentile = strtod(text, &end);
+        if (end == text || percentile < 0 || percentile > 100) {
+            return 0;
+        }
+        percentiles[num_percentiles++] = percentile;
+        if (*end == '\0') {
+            return num_percentiles;
+        }
+        if (*end != ',') {
+            return 0;
+        }
+        text = end + 1;
+    }
+    return 0;
+}
 
-    const int state_empty = 0; // initial state / whitespace was read, new number has not yet begun
-    const int state_sign = 1; // we read a -. Multiple - are allowed, e.g., --5 == 5
-    const int state_digit = 2; // we started reading digits - only digits and white spaces may follow after
-    const int state_done = 3; // we found a whitespace after a digit - number is done, write it out
-    int number_state = state_empty;
+bool write_percentiles(const char *filename, const double *percentiles, const int *results, size_t num_percentiles) {
+    FILE *fp = fopen(filename, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Cannot open file %s\n", filename);
+        return false;
+    }
+    for (size_t p = 0; p < num_percentiles; p++) {
+        fprintf(fp, "%g %d\n", percentiles[p], results[p]);
+    }
+    return fclose(fp) == 0;
+}
 
-    int number = 0;
-    while (!done) {
-        char c = fgetc(fp); // read single char
-        if (isspace(c)) {
-            if (number_state == state_sign) {
-                done = true;
-            } else if (number_state == state_digit) {
-                number_state = state_done;
-            }
-        } else if (c == '-') {
-            if (number_state == state_empty || number_state == state_sign) {
-                negative = !negative;
-                number_state = state_sign;
-            } else {
-                number_state = state_done;
-                done = true;
-            }
-        } else if (isdigit(c)) {
-            number *= 10;
-            number += c - '0';
-            number_state = state_digit;
-        } else {
-            done = true;
-            if (number_state == state_digit) {
-                number_state = state_done;
-            }
-        }
+/**
+ * Answers a --top/--bottom/--percentiles query. With a memory budget, the input is streamed instead of loaded:
+ * a bounded heap of k numbers for top/bottom, two counting passes for percentiles.
+ */
+bool run_query(int query, size_t k, const double *percentiles, size_t num_percentiles, const char *infile, const char *outfile, size_t memory_budget) {
+    int results[MAX_PERCENTILES];
+    size_t num_numbers;
 
-        if (number_state == state_done) {
-            if (negative) {
-                number *= -1;
+    if (memory_budget > 0) {
+        if (query == query_percentiles) {
+            if (!stream_percentiles(infile, percentiles, num_percentiles, results, &num_numbers)) {
+                return false;
             }
-            *numbers = number;
-            numbers++;
-            (*num_numbers)++;
-            number_state = state_empty;
-            negative = false;
-            number = 0;
+            return write_percentiles(outfile, percentiles, results, num_numbers > 0 ? num_percentiles : 0);
+        }
+        // the heap of the k numbers is the only thing that grows with the input, it has to fit into the budget
+        if (k > memory_budget / sizeof(int)) {
+            fprintf(stderr, "%zu numbers do not fit into a memory budget of %zu bytes\n", k, memory_budget);
+            return false;
         }
+        int *top = malloc(sizeof(int) * k);
+        size_t num_top;
+        if (top == NULL) {
+            fprintf(stderr, "Not enough memory for %zu numbers\n", k);
+            return false;
+        }
+        bool ok = stream_top_k(infile, k, query == query_top, top, &num_top)
+                  && write_sorted_numbers(outfile, top, num_top);
+        free(top);
+        return ok;
+    }
+
+    int *numbers;
+    if (!read_numbers(infile, &numbers, &num_numbers)) {
+        return false;
     }
-    fclose(fp);
+    bool ok;
+    if (query == query_percentiles) {
+        select_percentiles(numbers, num_numbers, percentiles, num_percentiles, results);
+        ok = write_percentiles(outfile, percentiles, results, num_numbers > 0 ? num_percentiles : 0);
+    } else {
+        select_top_k(numbers, num_numbers, k, query == query_top);
+        ok = write_sorted_numbers(outfile, numbers, k < num_numbers ? k : num_numbers);
+    }
+    free(numbers);
+    return ok;
 }
 
-/*
- * comparison function required for qsort()
- * -1 if a < b
- *  0 if a == b
- *  1 if a > b
- */
-int compare_numbers(const void *a, const void *b) {
-    return *(int*)a - *(int*)b; // cast the void pointers to int pointers before dereferencing
+void print_usage(const char *program) {
+    printf("Usage: %s [--algorithm radix|network|qsort] [--threads N] [--memory-budget SIZE] [--top K | --bottom K | --percentiles P,...] infile outfile\n", program);
+    printf("  --threads N           sort on N threads (0 = one per core), default 1\n");
+    printf("  --memory-budget SIZE  external merge sort using about SIZE bytes of memory (suffixes K, M, G)\n");
+    printf("  --top K               only write the K largest numbers, largest first\n");
+    printf("  --bottom K            only write the K smallest numbers\n");
+    printf("  --percentiles P,...   only write the given percentiles, e.g. 50,90,99\n");
 }
 
 int main(int argc, char *argv[]) {
-    if (argc != 3) {
-        printf("Usage: %s infile outfile", argv[0]);
+    sort_function sort = radix_sort;
+    int num_threads = 1;
+    size_t memory_budget = 0;
+    int query = query_none;
+    size_t k = 0;
+    double percentiles[MAX_PERCENTILES];
+    size_t num_percentiles = 0;
+    int arg = 1;
+    for (; arg < argc && strncmp(argv[arg], "--", 2) == 0; arg++) {
+        if (strcmp(argv[arg], "--algorithm") == 0 && arg + 1 < argc) {
+            arg++;
+            if (strcmp(argv[arg], "qsort") == 0) {
+                sort = qsort_numbers;
+            } else if (strcmp(argv[arg], "radix") == 0) {
+                sort = radix_sort;
+            } else if (strcmp(argv[arg], "network") == 0) {
+                sort = network_sort;
+            } else {
+                print_usage(argv[0]);
+                exit(1);
+            }
+        } else if (strcmp(argv[arg], "--threads") == 0 && arg + 1 < argc) {
+            arg++;
+            char *end;
+            long value = strtol(argv[arg], &end, 10);
+            if (end == argv[arg] || *end != '\0' || value < 0 || value > INT_MAX) {
+                print_usage(argv[0]);
+                exit(1);
+            }
+            num_threads = (int) value;
+        } else if (strcmp(argv[arg], "--memory-budget") == 0 && arg + 1 < argc) {
+            arg++;
+            memory_budget = parse_size(argv[arg]);
+            if (memory_budget == 0) {
+                print_usage(argv[0]);
+                exit(1);
+            }
+        } else if ((strcmp(argv[arg], "--top") == 0 || strcmp(argv[arg], "--bottom") == 0) && arg + 1 < argc && query == query_none) {
+            query = strcmp(argv[arg], "--top") == 0 ? query_top : query_bottom;
+            arg++;
+            // a positive number and nothing else, strtoull alone would take "abc" as 0 and "-1" as a huge k
+            char *end;
+            k = strtoull(argv[arg], &end, 10);
+            if (!isdigit((unsigned char) argv[arg][0]) || *end != '\0' || k == 0) {
+                print_usage(argv[0]);
+                exit(1);
+            }
+        } else if (strcmp(argv[arg], "--percentiles") == 0 && arg + 1 < argc && query == query_none) {
+            query = query_percentiles;
+            arg++;
+            num_percentiles = parse_percentiles(argv[arg], percentiles);
+            if (num_percentiles == 0) {
+                print_usage(argv[0]);
+                exit(1);
+            }
+        } else {
+            print_usage(argv[0]);
+            exit(1);
+        }
+    }
+    if (argc - arg != 2) {
+        print_usage(argv[0]);
         exit(1);
     }
+    const char *infile = argv[arg];
+    const char *outfile = argv[arg + 1];
 
-    /*
-     * allocate an array of sufficient size.
-     * wc -l file02.txt claims the file has 1048576 == 2^20 rows
-     * It doesnt seem like a line contains multiple numbers in the second file, but just to be sure, allocate twice as much memory (2^21 ints)
-     *
-     * I would prefer to use int numbers[2 << 21] (automatic memory management, on stack), but that causes a stack overflow as soon as the program starts.
-     * Instead, I have to allocate the memory on the heap, using malloc:
-     */
-    int *numbers = malloc(sizeof(int) * (1 << 21));
-    int num_numbers = 0;
-    read_numbers(argv[1], numbers, &num_numbers);
-    qsort(numbers, num_numbers, sizeof(int), compare_numbers);
-    write_sorted_numbers(argv[2], numbers, num_numbers);
-    // TODO: maybe I should free the allocated memory from numbers, but the program terminates now anyway, so the OS should do it for me
-    return 0;
-}
+    if (query != query_none) {
+        return run_query(query, k, percentiles, num_percentiles, infile, outfile, memory_budget) ? 0 : 1;
+    }
+
+    if (memory_budget > 0) {
+        return external_sort(infile, outfile, memory_budget, num_threads, sort) ? 0 : 1;
+    }
+
+    // the whole input is read into memory, read_numbers grows the array as needed
+    int *numbers;
+    size_t num_numbers;
+    if (!read_numbers(infile, &numbers, &num_numbers)) {
+        return 1;
+    }
+    parallel_sort(numbers, num_numbers, num_threads, sort);
+    bool written = write_sorted_numbers(outfile, numbers, num_numbers);
+    free(numbers);
+    return written ? 0 : 1;
+}
\ No newline at end of file
@@ -0,0 +1,211 @@
+#include "network_sort.h"
+
+#include <limits.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sort.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_AVX2_SORT 1
+#include <immintrin.h>
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+#define BLOCK_SIZE 64 // numbers sorted by one network invocation (8 registers of 8 numbers)
+#define RUN_SIZE 8 // sorted runs after the network phase
+
+/*
+ * optimal sorting network for 8 inputs (19 comparators in 6 layers)
+ */
+static const int network8[19][2] = {
+        {0, 2}, {1, 3}, {4, 6}, {5, 7},
+        {0, 4}, {1, 5}, {2, 6}, {3, 7},
+        {0, 1}, {2, 3}, {4, 5}, {6, 7},
+        {2, 4}, {3, 5},
+        {1, 4}, {3, 6},
+        {1, 2}, {3, 4}, {5, 6},
+};
+
+/* ---------------------------------------------------------------- scalar fallback */
+
+static void scalar_sort_runs(int *numbers, size_t num_numbers) {
+    for (size_t run = 0; run < num_numbers; run += RUN_SIZE) {
+        int *v = numbers + run;
+        for (int c = 0; c < 19; c++) {
+            int a = v[network8[c][0]];
+            int b = v[network8[c][1]];
+            // compiles to cmov, no branches
+            v[network8[c][0]] = a < b ? a : b;
+            v[network8[c][1]] = a < b ? b : a;
+        }
+    }
+}
+
+static void scalar_merge(const int *a, size_t length_a, const int *b, size_t length_b, int *out) {
+    const int *end_a = a + length_a;
+    const int *end_b = b + length_b;
+    while (a < end_a && b < end_b) {
+        // branch-free: both pointers advance by the result of the comparison
+        bool take_b = *b < *a;
+        *out++ = take_b ? *b : *a;
+        b += take_b;
+        a += !take_b;
+    }
+    memcpy(out, a, sizeof(int) * (end_a - a));
+    out += end_a - a;
+    memcpy(out, b, sizeof(int) * (end_b - b));
+}
+
+/* ---------------------------------------------------------------- AVX2 */
+
+#ifdef HAVE_AVX2_SORT
+
+static inline AVX2 void compare_exchange(__m256i *a, __m256i *b) {
+    __m256i min = _mm256_min_epi32(*a, *b);
+    *b = _mm256_max_epi32(*a, *b);
+    *a = min;
+}
+
+static inline AVX2 void transpose8x8(__m256i r[8]) {
+    __m256i t[8], u[8];
+    for (int i = 0; i < 8; i += 2) {
+        t[i] = _mm256_unpacklo_epi32(r[i], r[i + 1]);
+        t[i + 1] = _mm256_unpackhi_epi32(r[i], r[i + 1]);
+    }
+    for (int i = 0; i < 8; i += 4) {
+        u[i] = _mm256_unpacklo_epi64(t[i], t[i + 2]);
+        u[i + 1] = _mm256_unpackhi_epi64(t[i], t[i + 2]);
+        u[i + 2] = _mm256_unpacklo_epi64(t[i + 1], t[i + 3]);
+        u[i + 3] = _mm256_unpackhi_epi64(t[i + 1], t[i + 3]);
+    }
+    for (int i = 0; i < 4; i++) {
+        r[i] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x20);
+        r[i + 4] = _mm256_permute2x128_si256(u[i], u[i + 4], 0x31);
+    }
+}
+
+// sorts every block of 64 numbers into 8 sorted runs of 8: the network sorts the columns, the transpose turns them into rows
+static AVX2 void avx2_sort_runs(int *numbers, size_t num_numbers) {
+    for (size_t block = 0; block < num_numbers; block += BLOCK_SIZE) {
+        __m256i r[8];
+        for (int i = 0; i < 8; i++) {
+            r[i] = _mm256_loadu_si256((const __m256i*) (numbers + block + 8 * i));
+        }
+        for (int c = 0; c < 19; c++) {
+            compare_exchange(&r[network8[c][0]], &r[network8[c][1]]);
+        }
+        transpose8x8(r);
+        for (int i = 0; i < 8; i++) {
+            _mm256_storeu_si256((__m256i*) (numbers + block + 8 * i), r[i]);
+        }
+    }
+}
+
+// sorts a bitonic sequence of 8: compare-exchange at distance 4, 2 and 1
+static inline AVX2 __m256i bitonic_clean(__m256i x) {
+    __m256i y = _mm256_permute2x128_si256(x, x, 0x01);
+    x = _mm256_blend_epi32(_mm256_min_epi32(x, y), _mm256_max_epi32(x, y), 0xF0);
+    y = _mm256_shuffle_epi32(x, _MM_SHUFFLE(1, 0, 3, 2));
+    x = _mm256_blend_epi32(_mm256_min_epi32(x, y), _mm256_max_epi32(x, y), 0xCC);
+    y = _mm256_shuffle_epi32(x, _MM_SHUFFLE(2, 3, 0, 1));
+    x = _mm256_blend_epi32(_mm256_min_epi32(x, y), _mm256_max_epi32(x, y), 0xAA);
+    return x;
+}
+
+// merges the sorted vectors a and b: afterwards a holds the 8 smallest, b the 8 largest numbers, both sorted
+static inline AVX2 void bitonic_merge(__m256i *a, __m256i *b) {
+    // a ascending + b descending is bitonic, one min/max splits it into two bitonic halves
+    __m256i reversed = _mm256_permutevar8x32_epi32(*b, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+    __m256i low = _mm256_min_epi32(*a, reversed);
+    __m256i high = _mm256_max_epi32(*a, reversed);
+    *a = bitonic_clean(low);
+    *b = bitonic_clean(high);
+}
+
+// merges two sorted arrays whose lengths are multiples of 8, 8 numbers per step
+static AVX2 void avx2_merge(const int *a, size_t length_a, const int *b, size_t length_b, int *out) {
+    if (length_a == 0 || length_b == 0) {
+        scalar_merge(a, length_a, b, length_b, out);
+        return;
+    }
+    const int *end_a = a + length_a;
+    const int *end_b = b + length_b;
+    __m256i low = _mm256_loadu_si256((const __m256i*) a);
+    __m256i high = _mm256_loadu_si256((const __m256i*) b);
+    a += 8;
+    b += 8;
+    while (true) {
+        bitonic_merge(&low, &high);
+        _mm256_storeu_si256((__m256i*) out, low);
+        out += 8;
+        // the next 8 numbers come from the input with the smaller head, everything still in `high` is <= both heads' successors
+        if (a < end_a && (b == end_b || *a <= *b)) {
+            low = _mm256_loadu_si256((const __m256i*) a);
+            a += 8;
+        } else if (b < end_b) {
+            low = _mm256_loadu_si256((const __m256i*) b);
+            b += 8;
+        } else {
+            break;
+        }
+    }
+    _mm256_storeu_si256((__m256i*) out, high);
+}
+
+#endif
+
+/* ---------------------------------------------------------------- driver */
+
+void network_sort(int *numbers, size_t num_numbers) {
+    if (num_numbers < 2) {
+        return;
+    }
+    // pad to whole blocks with INT_MAX, which sorts to the end and is cut off again afterwards.
+    // Every run is then a multiple of 8 numbers long
+    size_t padded = (num_numbers + BLOCK_SIZE - 1) / BLOCK_SIZE * BLOCK_SIZE;
+    int *buffer = malloc(sizeof(int) * 2 * padded);
+    if (buffer == NULL) {
+        radix_sort(numbers, num_numbers);
+        return;
+    }
+    int *source = buffer;
+    int *target = buffer + padded;
+    memcpy(source, numbers, sizeof(int) * num_numbers);
+    for (size_t i = num_numbers; i < padded; i++) {
+        source[i] = INT_MAX;
+    }
+
+    void (*merge)(const int*, size_t, const int*, size_t, int*) = scalar_merge;
+#ifdef HAVE_AVX2_SORT
+    if (__builtin_cpu_supports("avx2")) {
+        avx2_sort_runs(source, padded);
+        merge = avx2_merge;
+    } else {
+        scalar_sort_runs(source, padded);
+    }
+#else
+    scalar_sort_runs(source, padded);
+#endif
+
+    // bottom up merge sort, doubling the run length in every pass
+    for (size_t width = RUN_SIZE; width < padded; width *= 2) {
+        for (size_t first = 0; first < padded; first += 2 * width) {
+            size_t middle = first + width < padded ? first + width : padded;
+            size_t last = first + 2 * width < padded ? first + 2 * width : padded;
+            if (middle == last || source[middle - 1] <= source[middle]) {
+                // already in order, which is common for nearly sorted input
+                memcpy(target + first, source + first, sizeof(int) * (last - first));
+            } else {
+                merge(source + first, middle - first, source + middle, last - middle, target + first);
+            }
+        }
+        int *tmp = source;
+        source = target;
+        target = tmp;
+    }
+
+    memcpy(numbers, source, sizeof(int) * num_numbers);
+    free(buffer);
+}
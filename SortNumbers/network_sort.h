@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Comparison based merge sort without comparator callback:
+ * blocks of 64 numbers are sorted by a sorting network (8 columns at once in AVX2 registers, then transposed into
+ * 8 sorted rows), and the sorted runs are combined by a merge which outputs 8 numbers per bitonic merge network.
+ * On CPUs without AVX2 the same structure runs with branch-free scalar code.
+ * @param numbers
+ * @param num_numbers
+ */
+void network_sort(int *numbers, size_t num_numbers);
@@ -0,0 +1,321 @@
+#include "number_io.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define READ_PADDING 8 // zero bytes after the filled part of the read buffer, so that 8 byte loads never read past it
+#define MAX_NUMBER_LENGTH 12 // "-2147483648\n"
+#define MAX_WRITE_BUFFER (1 << 28)
+
+static const int state_empty = 0; // initial state / whitespace was read, new number has not yet begun
+static const int state_sign = 1; // we read a -. Multiple - are allowed, e.g., --5 == 5
+static const int state_digit = 2; // we started reading digits - only digits and white spaces may follow after
+static const int state_done = 3; // we found a whitespace after a digit - number is done, write it out
+
+static const uint32_t powers_of_ten[] = {1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000};
+
+bool number_reader_open(number_reader *reader, const char *filename) {
+    reader->fd = open(filename, O_RDONLY);
+    if (reader->fd < 0) {
+        fprintf(stderr, "Cannot open file %s\n", filename);
+        return false;
+    }
+    reader->buffer = malloc(IO_BUFFER_SIZE + READ_PADDING);
+    if (reader->buffer == NULL) {
+        close(reader->fd);
+        fprintf(stderr, "Not enough memory to read %s\n", filename);
+        return false;
+    }
+    reader->position = 0;
+    reader->filled = 0;
+    reader->eof = false;
+    reader->done = false;
+    reader->negative = false;
+    reader->number_state = state_empty;
+    reader->number = 0;
+    return true;
+}
+
+static void fill_buffer(number_reader *reader) {
+    ssize_t bytes_read;
+    do {
+        bytes_read = read(reader->fd, reader->buffer, IO_BUFFER_SIZE);
+    } while (bytes_read < 0 && errno == EINTR);
+    if (bytes_read <= 0) {
+        // read errors end the input just like EOF
+        bytes_read = 0;
+        reader->eof = true;
+    }
+    reader->position = 0;
+    reader->filled = bytes_read;
+    memset(reader->buffer + bytes_read, 0, READ_PADDING);
+}
+
+/*
+ * Counts the leading digits of the 8 characters in chunk (SWAR, first character in the lowest byte).
+ * The most significant bit is masked first, so that none of the per-byte additions can carry into the next byte.
+ */
+static inline int count_digits(uint64_t chunk) {
+    const uint64_t high_bits = 0x8080808080808080ull;
+    uint64_t low = chunk & ~high_bits;
+    uint64_t at_least_0 = low + 0x5050505050505050ull; // high bit set iff byte >= '0'
+    uint64_t above_9 = low + 0x4646464646464646ull; // high bit set iff byte > '9'
+    uint64_t digits = at_least_0 & ~above_9 & ~chunk & high_bits;
+    uint64_t non_digits = ~digits & high_bits;
+    return non_digits == 0 ? 8 : __builtin_ctzll(non_digits) / 8;
+}
+
+/*
+ * Converts the first num_digits (1 to 8) characters of chunk to a number (SWAR):
+ * the digits are moved to the most significant bytes, the freed bytes become leading zeros,
+ * then neighbouring digits, pairs and quadruples are combined with one multiplication each.
+ */
+static inline uint32_t parse_digits(uint64_t chunk, int num_digits) {
+    chunk = (chunk - 0x3030303030303030ull) << (8 * (8 - num_digits));
+    chunk = (chunk * 10 + (chunk >> 8)) & 0x00FF00FF00FF00FFull;
+    chunk = (chunk * 100 + (chunk >> 16)) & 0x0000FFFF0000FFFFull;
+    chunk = (chunk * 10000 + (chunk >> 32)) & 0x00000000FFFFFFFFull;
+    return (uint32_t) chunk;
+}
+
+/**
+ * function to read whitespace-separated numbers from the reader's file.
+ * The main loop for parsing a number is:
+ *
+ * num = 0
+ * while (next char is number)
+ *    number = number * 10 + next char
+ * write num to the numbers array, num = 0
+ *
+ * Runs of digits are consumed up to 8 characters at a time (count_digits, parse_digits),
+ * everything else goes through the character wise state machine.
+ * Reading stops after max_numbers numbers, the parser state is kept in the reader, so that the next call continues
+ * where this one stopped.
+ * @param reader
+ * @param numbers
+ * @param max_numbers
+ * @return the number of numbers read, less than max_numbers only if the input is done
+ */
+size_t read_numbers_chunk(number_reader *reader, int *numbers, size_t max_numbers) {
+    // Input ends either on EOF or when encountering a format error, e.g., 34x, or a minus without a digit ("- ")
+    size_t num_numbers = 0;
+    while (!reader->done && num_numbers < max_numbers) {
+        if (reader->position == reader->filled && !reader->eof) {
+            fill_buffer(reader);
+        }
+        const char *pos = reader->buffer + reader->position;
+
+        uint64_t chunk;
+        memcpy(&chunk, pos, sizeof(chunk));
+        int num_digits = count_digits(chunk);
+        if (num_digits > 0) {
+            // the padding after the buffer contains no digits, so num_digits never reaches past the filled part
+            reader->number = reader->number * powers_of_ten[num_digits] + parse_digits(chunk, num_digits);
+            reader->number_state = state_digit;
+            reader->position += num_digits;
+            continue;
+        }
+
+        char c;
+        if (reader->position == reader->filled) {
+            c = EOF; // EOF ends a number just like any other unexpected character
+        } else {
+            c = *pos;
+            reader->position++;
+        }
+        if (c == ' ' || (c >= '\t' && c <= '\r')) {
+            if (reader->number_state == state_sign) {
+                reader->done = true;
+            } else if (reader->number_state == state_digit) {
+                reader->number_state = state_done;
+            }
+        } else if (c == '-') {
+            if (reader->number_state == state_empty || reader->number_state == state_sign) {
+                reader->negative = !reader->negative;
+                reader->number_state = state_sign;
+            } else {
+                reader->number_state = state_done;
+                reader->done = true;
+            }
+        } else {
+            reader->done = true;
+            if (reader->number_state == state_digit) {
+                reader->number_state = state_done;
+            }
+        }
+
+        if (reader->number_state == state_done) {
+            if (reader->negative) {
+                reader->number = 0u - reader->number;
+            }
+            numbers[num_numbers] = (int) reader->number;
+            num_numbers++;
+            reader->number_state = state_empty;
+            reader->negative = false;
+            reader->number = 0;
+        }
+    }
+    return num_numbers;
+}
+
+void number_reader_close(number_reader *reader) {
+    close(reader->fd);
+    free(reader->buffer);
+}
+
+/**
+ * @param writer
+ * @param filename
+ * @param buffer_size bytes formatted before they are written, at least MAX_NUMBER_LENGTH
+ */
+bool number_writer_open(number_writer *writer, const char *filename, size_t buffer_size) {
+    if (buffer_size < MAX_NUMBER_LENGTH) {
+        buffer_size = MAX_NUMBER_LENGTH;
+    }
+    writer->fd = open(filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (writer->fd < 0) {
+        fprintf(stderr, "Cannot open file %s\n", filename);
+        return false;
+    }
+    writer->buffer = malloc(buffer_size);
+    if (writer->buffer == NULL) {
+        close(writer->fd);
+        fprintf(stderr, "Not enough memory to write %s\n", filename);
+        return false;
+    }
+    writer->capacity = buffer_size;
+    writer->filled = 0;
+    writer->ok = true;
+    return true;
+}
+
+static void flush_writer(number_writer *writer) {
+    size_t written = 0;
+    while (writer->ok && written < writer->filled) {
+        ssize_t result = write(writer->fd, writer->buffer + written, writer->filled - written);
+        if (result < 0 && errno != EINTR) {
+            writer->ok = false;
+        } else if (result > 0) {
+            written += result;
+        }
+    }
+    writer->filled = 0;
+}
+
+/*
+ * "00" "01" ... "99": two digits per table lookup
+ */
+static const char digit_pairs[201] =
+        "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+        "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+static inline int count_decimal_digits(uint32_t value) {
+    int digits = 1;
+    for (uint64_t limit = 10; digits < 10 && value >= limit; limit *= 10) {
+        digits++;
+    }
+    return digits;
+}
+
+// formats number plus newline at out, returns the number of characters written
+static inline size_t format_number(char *out, int number) {
+    char *start = out;
+    uint32_t value = (uint32_t) number;
+    if (number < 0) {
+        *out++ = '-';
+        value = 0u - value;
+    }
+    int digits = count_decimal_digits(value);
+    char *pos = out + digits;
+    while (value >= 100) {
+        pos -= 2;
+        memcpy(pos, &digit_pairs[2 * (value % 100)], 2);
+        value /= 100;
+    }
+    if (value >= 10) {
+        pos -= 2;
+        memcpy(pos, &digit_pairs[2 * value], 2);
+    } else {
+        *--pos = (char) ('0' + value);
+    }
+    out += digits;
+    *out++ = '\n';
+    return out - start;
+}
+
+void write_numbers(number_writer *writer, const int *numbers, size_t num_numbers) {
+    for (size_t i = 0; i < num_numbers; i++) {
+        if (writer->capacity - writer->filled < MAX_NUMBER_LENGTH) {
+            flush_writer(writer);
+        }
+        writer->filled += format_number(writer->buffer + writer->filled, numbers[i]);
+    }
+}
+
+bool number_writer_close(number_writer *writer) {
+    flush_writer(writer);
+    bool ok = writer->ok && close(writer->fd) == 0;
+    free(writer->buffer);
+    return ok;
+}
+
+/**
+ * Reads all numbers of the given file.
+ * The number of numbers is not known upfront, so the array is allocated here and doubled whenever it is full.
+ * @param filename
+ * @param numbers receives the array, has to be freed by the caller
+ * @param num_numbers
+ * @return false if the file cannot be opened or there is not enough memory
+ */
+bool read_numbers(const char *filename, int **numbers, size_t *num_numbers) {
+    number_reader reader;
+    if (!number_reader_open(&reader, filename)) {
+        return false;
+    }
+
+    size_t capacity = 1 << 20;
+    *numbers = malloc(sizeof(int) * capacity);
+    *num_numbers = 0;
+    while (*numbers != NULL) {
+        *num_numbers += read_numbers_chunk(&reader, *numbers + *num_numbers, capacity - *num_numbers);
+        if (*num_numbers < capacity) {
+            break; // input done
+        }
+        capacity *= 2;
+        int *grown = realloc(*numbers, sizeof(int) * capacity);
+        if (grown == NULL) {
+            free(*numbers);
+        }
+        *numbers = grown;
+    }
+    number_reader_close(&reader);
+
+    if (*numbers == NULL) {
+        fprintf(stderr, "Not enough memory to read %s, consider --memory-budget\n", filename);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writes the sorted numbers, one per line.
+ * The buffer is large enough for the longest possible output, so everything goes out with a single write()
+ * (outputs beyond MAX_WRITE_BUFFER are written in blocks of that size).
+ * @param filename
+ * @param sorted_numbers
+ * @param num_numbers
+ */
+bool write_sorted_numbers(const char *filename, const int *sorted_numbers, size_t num_numbers) {
+    number_writer writer;
+    size_t buffer_size = num_numbers * MAX_NUMBER_LENGTH;
+    if (!number_writer_open(&writer, filename, buffer_size < MAX_WRITE_BUFFER ? buffer_size : MAX_WRITE_BUFFER)) {
+        return false;
+    }
+    write_numbers(&writer, sorted_numbers, num_numbers);
+    return number_writer_close(&writer);
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define IO_BUFFER_SIZE (1 << 20) // large blocks, so that reading and writing runs at disk speed
+
+/*
+ * State of the number parser, so that a file can be read in several chunks (see read_numbers_chunk).
+ * The file is read in large blocks with read(), bypassing stdio.
+ */
+typedef struct {
+    int fd;
+    char *buffer;
+    size_t position;
+    size_t filled;
+    bool eof;
+    bool done; // EOF or format error reached
+    bool negative;
+    int number_state;
+    uint32_t number; // unsigned, so that the overflow of e.g. INT_MIN while parsing is well defined
+} number_reader;
+
+/*
+ * Text output of numbers, one per line. The numbers are formatted into one large buffer,
+ * which is handed to write() whenever it is full.
+ */
+typedef struct {
+    int fd;
+    char *buffer;
+    size_t capacity;
+    size_t filled;
+    bool ok;
+} number_writer;
+
+bool number_reader_open(number_reader *reader, const char *filename);
+size_t read_numbers_chunk(number_reader *reader, int *numbers, size_t max_numbers);
+void number_reader_close(number_reader *reader);
+
+bool number_writer_open(number_writer *writer, const char *filename, size_t buffer_size);
+void write_numbers(number_writer *writer, const int *numbers, size_t num_numbers);
+bool number_writer_close(number_writer *writer);
+
+bool read_numbers(const char *filename, int **numbers, size_t *num_numbers);
+bool write_sorted_numbers(const char *filename, const int *sorted_numbers, size_t num_numbers);
@@ -0,0 +1,234 @@
+#include "parallel_sort.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define SAMPLES_PER_THREAD 64 // oversampling factor, more samples -> better balanced buckets
+#define MIN_NUMBERS_PER_THREAD (1 << 16) // below that, starting threads does not pay off
+
+/*
+ * Splitters and samples are (value, position) pairs, ordered by value first and position second.
+ * All positions are distinct, so even inputs consisting of a single repeated value are split evenly.
+ */
+typedef struct {
+    int value;
+    size_t position;
+} tagged_number;
+
+static inline int tagged_less(int value_a, size_t position_a, const tagged_number *b) {
+    return value_a < b->value || (value_a == b->value && position_a < b->position);
+}
+
+static int compare_tagged(const void *a, const void *b) {
+    const tagged_number *x = a;
+    const tagged_number *y = b;
+    if (tagged_less(x->value, x->position, y)) {
+        return -1;
+    }
+    return x->value != y->value || x->position != y->position;
+}
+
+/*
+ * Holds the started threads back until all of them are running, so a failed pthread_create can still call off the
+ * parallel sort before anyone waits at the barrier for the missing thread
+ */
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+    int state; // 0 = closed, 1 = open, -1 = called off
+} start_gate;
+
+static void start_gate_set(start_gate *gate, int state) {
+    pthread_mutex_lock(&gate->mutex);
+    gate->state = state;
+    pthread_cond_broadcast(&gate->changed);
+    pthread_mutex_unlock(&gate->mutex);
+}
+
+// false if the sort was called off
+static bool start_gate_pass(start_gate *gate) {
+    pthread_mutex_lock(&gate->mutex);
+    while (gate->state == 0) {
+        pthread_cond_wait(&gate->changed, &gate->mutex);
+    }
+    const bool open = gate->state > 0;
+    pthread_mutex_unlock(&gate->mutex);
+    return open;
+}
+
+typedef struct {
+    int id;
+    int num_threads;
+    int *numbers;
+    int *scratch;
+    size_t num_numbers;
+    sort_function sort;
+    const tagged_number *splitters; // num_threads - 1 splitters
+    uint16_t *buckets; // bucket of every number
+    size_t *counts; // counts[thread * num_threads + bucket], turned into output offsets
+    pthread_barrier_t *barrier;
+    start_gate *gate;
+} sort_worker;
+
+static size_t find_bucket(const tagged_number *splitters, int num_splitters, int value, size_t position) {
+    // binary search for the number of splitters smaller than (value, position)
+    int low = 0;
+    int high = num_splitters;
+    while (low < high) {
+        int mid = (low + high) / 2;
+        if (tagged_less(value, position, &splitters[mid])) {
+            high = mid;
+        } else {
+            low = mid + 1;
+        }
+    }
+    return low;
+}
+
+static void *sort_worker_run(void *arg) {
+    sort_worker *worker = arg;
+    const int p = worker->num_threads;
+    const size_t first = worker->num_numbers * worker->id / p;
+    const size_t last = worker->num_numbers * (worker->id + 1) / p;
+    size_t *counts = worker->counts + (size_t) worker->id * p;
+
+    // 1. classify the own chunk
+    for (size_t i = first; i < last; i++) {
+        size_t bucket = find_bucket(worker->splitters, p - 1, worker->numbers[i], i);
+        worker->buckets[i] = bucket;
+        counts[bucket]++;
+    }
+    pthread_barrier_wait(worker->barrier);
+
+    // 2. thread 0 turns the counts into offsets: bucket by bucket, and within a bucket thread by thread
+    if (worker->id == 0) {
+        size_t offset = 0;
+        for (int bucket = 0; bucket < p; bucket++) {
+            for (int thread = 0; thread < p; thread++) {
+                size_t count = worker->counts[(size_t) thread * p + bucket];
+                worker->counts[(size_t) thread * p + bucket] = offset;
+                offset += count;
+            }
+        }
+    }
+    pthread_barrier_wait(worker->barrier);
+
+    // bucket boundaries for step 4, read before step 3 modifies the offsets
+    const size_t bucket_first = worker->counts[worker->id];
+    const size_t bucket_last = worker->id + 1 < p ? worker->counts[worker->id + 1] : worker->num_numbers;
+    pthread_barrier_wait(worker->barrier);
+
+    // 3. scatter the own chunk into the buckets
+    for (size_t i = first; i < last; i++) {
+        worker->scratch[counts[worker->buckets[i]]++] = worker->numbers[i];
+    }
+    pthread_barrier_wait(worker->barrier);
+
+    // 4. sort the own bucket and copy it back
+    worker->sort(worker->scratch + bucket_first, bucket_last - bucket_first);
+    memcpy(worker->numbers + bucket_first, worker->scratch + bucket_first, sizeof(int) * (bucket_last - bucket_first));
+    return NULL;
+}
+
+static void *sort_worker_thread(void *arg) {
+    sort_worker *worker = arg;
+    return start_gate_pass(worker->gate) ? sort_worker_run(worker) : NULL;
+}
+
+int parallel_sort_threads(size_t num_numbers, int num_threads) {
+    if (num_threads <= 0) {
+        num_threads = (int) sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if ((size_t) num_threads > num_numbers / MIN_NUMBERS_PER_THREAD) {
+        num_threads = (int) (num_numbers / MIN_NUMBERS_PER_THREAD);
+    }
+    if (num_threads > UINT16_MAX) {
+        num_threads = UINT16_MAX;
+    }
+    return num_threads;
+}
+
+void parallel_sort(int *numbers, size_t num_numbers, int num_threads, sort_function sort) {
+    num_threads = parallel_sort_threads(num_numbers, num_threads);
+    if (num_threads <= 1) {
+        sort(numbers, num_numbers);
+        return;
+    }
+    const int p = num_threads;
+
+    // choose the splitters from an evenly spaced sample
+    size_t num_samples = (size_t) p * SAMPLES_PER_THREAD;
+    tagged_number *samples = malloc(sizeof(tagged_number) * num_samples);
+    int *scratch = malloc(sizeof(int) * num_numbers);
+    uint16_t *buckets = malloc(sizeof(uint16_t) * num_numbers);
+    size_t *counts = calloc((size_t) p * p, sizeof(size_t));
+    sort_worker *workers = malloc(sizeof(sort_worker) * p);
+    pthread_t *threads = malloc(sizeof(pthread_t) * p);
+    if (!samples || !scratch || !buckets || !counts || !workers || !threads) {
+        free(samples); free(scratch); free(buckets); free(counts); free(workers); free(threads);
+        sort(numbers, num_numbers);
+        return;
+    }
+
+    for (size_t i = 0; i < num_samples; i++) {
+        size_t position = num_numbers / num_samples * i + (num_numbers / num_samples) / 2;
+        samples[i].value = numbers[position];
+        samples[i].position = position;
+    }
+    qsort(samples, num_samples, sizeof(tagged_number), compare_tagged);
+    // the splitters are every SAMPLES_PER_THREAD-th sample, they are moved to the front of the sample array
+    for (int i = 1; i < p; i++) {
+        samples[i - 1] = samples[(size_t) i * SAMPLES_PER_THREAD];
+    }
+
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, p);
+    start_gate gate = { .state = 0 };
+    pthread_mutex_init(&gate.mutex, NULL);
+    pthread_cond_init(&gate.changed, NULL);
+    for (int id = 0; id < p; id++) {
+        workers[id] = (sort_worker) {
+            .id = id,
+            .num_threads = p,
+            .numbers = numbers,
+            .scratch = scratch,
+            .num_numbers = num_numbers,
+            .sort = sort,
+            .splitters = samples,
+            .buckets = buckets,
+            .counts = counts,
+            .barrier = &barrier,
+            .gate = &gate,
+        };
+    }
+    // the calling thread works as worker 0
+    int started = 1;
+    while (started < p && pthread_create(&threads[started], NULL, sort_worker_thread, &workers[started]) == 0) {
+        started++;
+    }
+    start_gate_set(&gate, started == p ? 1 : -1);
+    if (started == p) {
+        sort_worker_run(&workers[0]);
+    }
+    for (int id = 1; id < started; id++) {
+        pthread_join(threads[id], NULL);
+    }
+    if (started < p) {
+        // not enough threads, nothing has been touched yet
+        sort(numbers, num_numbers);
+    }
+    pthread_barrier_destroy(&barrier);
+    pthread_mutex_destroy(&gate.mutex);
+    pthread_cond_destroy(&gate.changed);
+
+    free(samples);
+    free(scratch);
+    free(buckets);
+    free(counts);
+    free(workers);
+    free(threads);
+}
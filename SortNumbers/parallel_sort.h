@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sort.h"
+
+/**
+ * Memory parallel_sort allocates per number on top of the sequential algorithm when it runs on more than one thread:
+ * the buffer the buckets are scattered into and the bucket of every number
+ */
+#define PARALLEL_SORT_BYTES_PER_NUMBER (sizeof(int) + sizeof(uint16_t))
+
+/**
+ * Number of threads parallel_sort actually starts for num_numbers numbers
+ * @param num_numbers
+ * @param num_threads requested number of threads, 0 = one per core
+ * @return 1 if the numbers are sorted sequentially
+ */
+int parallel_sort_threads(size_t num_numbers, int num_threads);
+
+/**
+ * Sample sort on num_threads pthreads:
+ * splitters are chosen from a sorted sample, every thread distributes its chunk of the input into the buckets
+ * between the splitters, and then sorts one bucket with the given sequential algorithm.
+ * The buckets are disjoint value ranges, so no merge is required afterwards.
+ * @param numbers
+ * @param num_numbers
+ * @param num_threads number of threads, 0 = one per core
+ * @param sort sequential algorithm used for the buckets
+ */
+void parallel_sort(int *numbers, size_t num_numbers, int num_threads, sort_function sort);
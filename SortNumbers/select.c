@@ -0,0 +1,294 @@
+#include "select.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "number_io.h"
+#include "sort.h"
+
+#define INSERTION_SORT_THRESHOLD 16
+#define STREAM_BLOCK (1 << 16) // numbers parsed per read_numbers_chunk call while streaming
+#define HALF_BUCKETS (1 << 16)
+
+static void insertion_sort(int *numbers, size_t num_numbers) {
+    for (size_t i = 1; i < num_numbers; i++) {
+        int number = numbers[i];
+        size_t j = i;
+        while (j > 0 && numbers[j - 1] > number) {
+            numbers[j] = numbers[j - 1];
+            j--;
+        }
+        numbers[j] = number;
+    }
+}
+
+static inline int median_of_three(int a, int b, int c) {
+    if (a > b) {
+        int tmp = a;
+        a = b;
+        b = tmp;
+    }
+    // now a <= b
+    if (c < a) {
+        return a;
+    }
+    return c < b ? c : b;
+}
+
+void select_nth(int *numbers, size_t num_numbers, size_t nth) {
+    size_t low = 0;
+    size_t high = num_numbers; // nth is always in [low, high)
+    // like introsort: if partitioning takes more than 2 log2(n) rounds, the pivots were bad
+    int depth_limit = 2;
+    for (size_t n = num_numbers; n > 1; n /= 2) {
+        depth_limit += 2;
+    }
+
+    while (high - low > INSERTION_SORT_THRESHOLD) {
+        if (depth_limit-- == 0) {
+            radix_sort(numbers + low, high - low);
+            return;
+        }
+        int pivot = median_of_three(numbers[low], numbers[low + (high - low) / 2], numbers[high - 1]);
+
+        // three-way partition [low, less) < pivot, [less, i) == pivot, (greater, high) > pivot, so duplicates end the search early
+        size_t less = low;
+        size_t i = low;
+        size_t greater = high;
+        while (i < greater) {
+            int number = numbers[i];
+            if (number < pivot) {
+                numbers[i++] = numbers[less];
+                numbers[less++] = number;
+            } else if (number > pivot) {
+                numbers[i] = numbers[--greater];
+                numbers[greater] = number;
+            } else {
+                i++;
+            }
+        }
+
+        if (nth < less) {
+            high = less;
+        } else if (nth >= greater) {
+            low = greater;
+        } else {
+            return; // nth is one of the numbers equal to the pivot
+        }
+    }
+    insertion_sort(numbers + low, high - low);
+}
+
+size_t percentile_index(double percentile, size_t num_numbers) {
+    double rank = ceil(percentile / 100.0 * num_numbers);
+    if (rank < 1) {
+        return 0;
+    }
+    if (rank > num_numbers) {
+        return num_numbers - 1;
+    }
+    return (size_t) rank - 1;
+}
+
+void select_top_k(int *numbers, size_t num_numbers, size_t k, bool largest) {
+    if (k > num_numbers) {
+        k = num_numbers;
+    }
+    if (k == 0) {
+        return;
+    }
+    if (largest) {
+        select_nth(numbers, num_numbers, num_numbers - k);
+        memmove(numbers, numbers + num_numbers - k, sizeof(int) * k);
+        radix_sort(numbers, k);
+        for (size_t i = 0; i < k / 2; i++) {
+            int tmp = numbers[i];
+            numbers[i] = numbers[k - 1 - i];
+            numbers[k - 1 - i] = tmp;
+        }
+    } else {
+        select_nth(numbers, num_numbers, k - 1);
+        radix_sort(numbers, k);
+    }
+}
+
+void select_percentiles(int *numbers, size_t num_numbers, const double *percentiles, size_t num_percentiles, int *results) {
+    if (num_numbers == 0) {
+        return;
+    }
+    // select the ranks in ascending order, every selection only has to look at the numbers after the previous rank
+    size_t *indices = malloc(sizeof(size_t) * num_percentiles);
+    if (indices == NULL) {
+        radix_sort(numbers, num_numbers);
+    }
+    for (size_t p = 0; p < num_percentiles && indices != NULL; p++) {
+        indices[p] = percentile_index(percentiles[p], num_numbers);
+    }
+    size_t first = 0;
+    while (indices != NULL) {
+        size_t next = num_numbers;
+        for (size_t p = 0; p < num_percentiles; p++) {
+            if (indices[p] >= first && indices[p] < next) {
+                next = indices[p];
+            }
+        }
+        if (next == num_numbers) {
+            break;
+        }
+        select_nth(numbers + first, num_numbers - first, next - first);
+        first = next + 1;
+    }
+    for (size_t p = 0; p < num_percentiles; p++) {
+        results[p] = numbers[percentile_index(percentiles[p], num_numbers)];
+    }
+    free(indices);
+}
+
+/*
+ * min-heap: after replacing the root, move it down until both children are larger
+ */
+static void sift_down(int *heap, size_t size, size_t node) {
+    int number = heap[node];
+    while (2 * node + 1 < size) {
+        size_t child = 2 * node + 1;
+        if (child + 1 < size && heap[child + 1] < heap[child]) {
+            child++;
+        }
+        if (heap[child] >= number) {
+            break;
+        }
+        heap[node] = heap[child];
+        node = child;
+    }
+    heap[node] = number;
+}
+
+bool stream_top_k(const char *infile, size_t k, bool largest, int *result, size_t *num_results) {
+    *num_results = 0;
+    number_reader reader;
+    if (!number_reader_open(&reader, infile)) {
+        return false;
+    }
+    int *block = malloc(sizeof(int) * STREAM_BLOCK);
+    if (block == NULL) {
+        number_reader_close(&reader);
+        return false;
+    }
+
+    // min-heap of the k largest numbers seen so far, its root is the one to be evicted next.
+    // For the smallest numbers, the heap contains ~number instead: ~ reverses the order without overflowing
+    int *heap = result;
+    size_t size = 0;
+    size_t num_read;
+    while (k > 0 && (num_read = read_numbers_chunk(&reader, block, STREAM_BLOCK)) > 0) {
+        for (size_t i = 0; i < num_read; i++) {
+            int number = largest ? block[i] : ~block[i];
+            if (size < k) {
+                // sift up
+                size_t node = size++;
+                while (node > 0 && heap[(node - 1) / 2] > number) {
+                    heap[node] = heap[(node - 1) / 2];
+                    node = (node - 1) / 2;
+                }
+                heap[node] = number;
+            } else if (number > heap[0]) {
+                heap[0] = number;
+                sift_down(heap, size, 0);
+            }
+        }
+    }
+    free(block);
+    number_reader_close(&reader);
+
+    // heap sort: repeatedly moving the root to the end leaves the most extreme number first
+    for (size_t end = size; end > 1; end--) {
+        int root = heap[0];
+        heap[0] = heap[end - 1];
+        heap[end - 1] = root;
+        sift_down(heap, end - 1, 0);
+    }
+    if (!largest) {
+        for (size_t i = 0; i < size; i++) {
+            heap[i] = ~heap[i];
+        }
+    }
+    *num_results = size;
+    return true;
+}
+
+// same mapping as radix_sort: sign bit flipped, so that the keys compare like the numbers
+static inline uint32_t select_key(int number) {
+    return (uint32_t) number ^ 0x80000000u;
+}
+
+// finds the bucket containing the element with the given rank, and the rank within the bucket
+static size_t find_bucket(const size_t *histogram, size_t rank, size_t *rank_in_bucket) {
+    size_t bucket = 0;
+    while (bucket + 1 < HALF_BUCKETS && rank >= histogram[bucket]) {
+        rank -= histogram[bucket];
+        bucket++;
+    }
+    *rank_in_bucket = rank;
+    return bucket;
+}
+
+bool stream_percentiles(const char *infile, const double *percentiles, size_t num_percentiles, int *results, size_t *num_numbers) {
+    *num_numbers = 0;
+    int *block = malloc(sizeof(int) * STREAM_BLOCK);
+    size_t *upper_histogram = calloc(HALF_BUCKETS, sizeof(size_t));
+    size_t *upper_buckets = malloc(sizeof(size_t) * num_percentiles);
+    size_t *ranks = malloc(sizeof(size_t) * num_percentiles);
+    size_t *lower_histograms = NULL;
+    bool ok = block && upper_histogram && upper_buckets && ranks;
+    number_reader reader;
+    size_t num_read;
+
+    // pass 1: count
+    if (ok && (ok = number_reader_open(&reader, infile))) {
+        while ((num_read = read_numbers_chunk(&reader, block, STREAM_BLOCK)) > 0) {
+            for (size_t i = 0; i < num_read; i++) {
+                upper_histogram[select_key(block[i]) >> 16]++;
+            }
+            *num_numbers += num_read;
+        }
+        number_reader_close(&reader);
+    }
+    if (ok && *num_numbers > 0) {
+        for (size_t p = 0; p < num_percentiles; p++) {
+            upper_buckets[p] = find_bucket(upper_histogram, percentile_index(percentiles[p], *num_numbers), &ranks[p]);
+        }
+        lower_histograms = calloc(num_percentiles * HALF_BUCKETS, sizeof(size_t));
+        ok = lower_histograms != NULL;
+    }
+
+    // pass 2: resolve the lower 16 bits within the buckets of the requested ranks
+    if (ok && *num_numbers > 0 && (ok = number_reader_open(&reader, infile))) {
+        while ((num_read = read_numbers_chunk(&reader, block, STREAM_BLOCK)) > 0) {
+            for (size_t i = 0; i < num_read; i++) {
+                uint32_t key = select_key(block[i]);
+                for (size_t p = 0; p < num_percentiles; p++) {
+                    if (key >> 16 == upper_buckets[p]) {
+                        lower_histograms[p * HALF_BUCKETS + (key & 0xFFFF)]++;
+                    }
+                }
+            }
+        }
+        number_reader_close(&reader);
+
+        for (size_t p = 0; p < num_percentiles; p++) {
+            size_t unused;
+            size_t lower = find_bucket(lower_histograms + p * HALF_BUCKETS, ranks[p], &unused);
+            results[p] = (int) (((uint32_t) upper_buckets[p] << 16 | (uint32_t) lower) ^ 0x80000000u);
+        }
+    }
+
+    free(block);
+    free(upper_histogram);
+    free(upper_buckets);
+    free(ranks);
+    free(lower_histograms);
+    return ok;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Introselect: reorders numbers so that numbers[nth] is the number that would be there after sorting,
+ * with no larger number before and no smaller number after it. O(n) on average, quickselect falls back to
+ * radix_sort on the remaining range if partitioning does not make progress.
+ * @param numbers
+ * @param num_numbers
+ * @param nth
+ */
+void select_nth(int *numbers, size_t num_numbers, size_t nth);
+
+/**
+ * index of the p-th percentile (nearest rank method) among num_numbers sorted numbers
+ * @param percentile between 0 and 100
+ * @param num_numbers must be > 0
+ */
+size_t percentile_index(double percentile, size_t num_numbers);
+
+/**
+ * moves the k largest (or smallest) numbers to the front of numbers, sorted from the most extreme one on
+ * @param numbers
+ * @param num_numbers
+ * @param k at most num_numbers numbers are selected
+ * @param largest true for the largest numbers, false for the smallest
+ */
+void select_top_k(int *numbers, size_t num_numbers, size_t k, bool largest);
+
+/**
+ * percentiles of the numbers (nearest rank method), reorders numbers
+ * @param numbers
+ * @param num_numbers if 0 the results are not set
+ * @param percentiles between 0 and 100
+ * @param num_percentiles
+ * @param results receives one number per percentile
+ */
+void select_percentiles(int *numbers, size_t num_numbers, const double *percentiles, size_t num_percentiles, int *results);
+
+/**
+ * k largest (or smallest) numbers of a file, without holding more than k numbers in memory (bounded heap)
+ * @param infile
+ * @param k
+ * @param largest true for the largest numbers, false for the smallest
+ * @param result array of at least k numbers, receives the numbers sorted from the most extreme one on
+ * @param num_results receives min(k, number of numbers in the file)
+ * @return false if the file cannot be read
+ */
+bool stream_top_k(const char *infile, size_t k, bool largest, int *result, size_t *num_results);
+
+/**
+ * exact percentiles of a file in two passes with constant memory: the first pass counts the numbers per
+ * upper 16 bits, the second pass counts the lower 16 bits of the numbers in the buckets holding a requested rank
+ * @param infile
+ * @param percentiles between 0 and 100
+ * @param num_percentiles
+ * @param results receives one number per percentile
+ * @param num_numbers receives the number of numbers in the file, if 0 the results are not set
+ * @return false if the file cannot be read
+ */
+bool stream_percentiles(const char *infile, const double *percentiles, size_t num_percentiles, int *results, size_t *num_numbers);
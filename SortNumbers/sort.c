@@ -0,0 +1,91 @@
+#include "sort.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RADIX_BITS 11
+#define RADIX_BUCKETS (1 << RADIX_BITS)
+#define RADIX_MASK (RADIX_BUCKETS - 1)
+#define RADIX_PASSES 3 // 3 * 11 bits >= 32 bits
+
+int compare_numbers(const void *a, const void *b) {
+    // cast the void pointers to int pointers before dereferencing
+    // a - b would overflow for large numbers of opposite sign, so compare instead
+    int x = *(const int*)a;
+    int y = *(const int*)b;
+    return (x > y) - (x < y);
+}
+
+void qsort_numbers(int *numbers, size_t num_numbers) {
+    qsort(numbers, num_numbers, sizeof(int), compare_numbers);
+}
+
+/*
+ * Flipping the sign bit maps INT_MIN..INT_MAX order-preserving onto 0..UINT32_MAX,
+ * so the keys can be sorted as unsigned numbers.
+ */
+static inline uint32_t radix_key(int number) {
+    return (uint32_t) number ^ 0x80000000u;
+}
+
+void radix_sort(int *numbers, size_t num_numbers) {
+    if (num_numbers < 2) {
+        return;
+    }
+    int *scratch = malloc(sizeof(int) * num_numbers);
+    if (scratch == NULL) {
+        qsort(numbers, num_numbers, sizeof(int), compare_numbers);
+        return;
+    }
+
+    // a single pass over the input builds the histograms for all digits
+    size_t *histograms = calloc(RADIX_PASSES * RADIX_BUCKETS, sizeof(size_t));
+    if (histograms == NULL) {
+        free(scratch);
+        qsort(numbers, num_numbers, sizeof(int), compare_numbers);
+        return;
+    }
+    for (size_t i = 0; i < num_numbers; i++) {
+        uint32_t key = radix_key(numbers[i]);
+        for (int pass = 0; pass < RADIX_PASSES; pass++) {
+            histograms[pass * RADIX_BUCKETS + ((key >> (pass * RADIX_BITS)) & RADIX_MASK)]++;
+        }
+    }
+
+    int *source = numbers;
+    int *target = scratch;
+    for (int pass = 0; pass < RADIX_PASSES; pass++) {
+        size_t *histogram = histograms + pass * RADIX_BUCKETS;
+        int shift = pass * RADIX_BITS;
+
+        // if all keys share this digit, the pass would not move anything
+        if (histogram[(radix_key(source[0]) >> shift) & RADIX_MASK] == num_numbers) {
+            continue;
+        }
+
+        // exclusive prefix sum: histogram[d] becomes the first output position of digit d
+        size_t offset = 0;
+        for (int digit = 0; digit < RADIX_BUCKETS; digit++) {
+            size_t count = histogram[digit];
+            histogram[digit] = offset;
+            offset += count;
+        }
+
+        for (size_t i = 0; i < num_numbers; i++) {
+            int number = source[i];
+            target[histogram[(radix_key(number) >> shift) & RADIX_MASK]++] = number;
+        }
+
+        int *tmp = source;
+        source = target;
+        target = tmp;
+    }
+
+    // after an odd number of executed passes the result lives in the scratch buffer
+    if (source != numbers) {
+        memcpy(numbers, source, sizeof(int) * num_numbers);
+    }
+    free(histograms);
+    free(scratch);
+}
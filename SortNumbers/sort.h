@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+
+/*
+ * comparison function required for qsort()
+ * -1 if a < b
+ *  0 if a == b
+ *  1 if a > b
+ */
+int compare_numbers(const void *a, const void *b);
+
+/*
+ * signature shared by all sorting algorithms, so that the parallel sort can use any of them for its buckets
+ */
+typedef void (*sort_function)(int *numbers, size_t num_numbers);
+
+/**
+ * qsort() with compare_numbers, as sort_function
+ * @param numbers
+ * @param num_numbers
+ */
+void qsort_numbers(int *numbers, size_t num_numbers);
+
+/**
+ * LSD radix sort with 11 bit digits (3 passes over 32 bit keys).
+ * Falls back to qsort if the scratch buffer cannot be allocated.
+ * @param numbers
+ * @param num_numbers
+ */
+void radix_sort(int *numbers, size_t num_numbers);